@@ -0,0 +1,224 @@
+#include "AssetLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+
+//-----------------------------------------------------------------------------
+// Constructor: starts the workers; threadCount 0 uses every hardware thread
+//-----------------------------------------------------------------------------
+AssetLoader::AssetLoader(unsigned int threadCount)
+	: mPending(0),
+	mStopping(false)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		mWorkers.push_back(std::thread(&AssetLoader::workerLoop, this));
+}
+
+//-----------------------------------------------------------------------------
+// Destructor: drops jobs not started yet and joins the workers
+//-----------------------------------------------------------------------------
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+		for (size_t i = 0; i < mJobs.size(); i++)
+			release(mJobs[i]);
+		mJobs.clear();
+	}
+	mJobReady.notify_all();
+	mUploadSpace.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); i++)
+		mWorkers[i].join();
+
+	for (size_t i = 0; i < mUploads.size(); i++)
+		release(mUploads[i]);
+}
+
+//-----------------------------------------------------------------------------
+// Queues a mesh; its vertex format, LOD count and arena must be set already
+//-----------------------------------------------------------------------------
+void AssetLoader::loadMesh(Mesh* mesh, const std::string& filename, bool optimize)
+{
+	Job job = { mesh, NULL, filename, optimize, false, NULL, 0, NULL, NULL };
+	submit(job);
+}
+
+//-----------------------------------------------------------------------------
+// Queues a texture
+//-----------------------------------------------------------------------------
+void AssetLoader::loadTexture(Texture2D* texture, const std::string& filename, bool generateMipMaps)
+{
+	Job job = { NULL, texture, filename, generateMipMaps, false, NULL, 0, NULL, NULL };
+	submit(job);
+}
+
+//-----------------------------------------------------------------------------
+// Queues an image for a texture array layer
+//-----------------------------------------------------------------------------
+void AssetLoader::loadTextureLayer(TextureArray* array, GLint layer, const std::string& filename)
+{
+	Job job = { NULL, new Texture2D(), filename, false, false, array, layer, NULL, NULL };
+	submit(job);
+}
+
+//-----------------------------------------------------------------------------
+// Queues an image for a texture atlas
+//-----------------------------------------------------------------------------
+void AssetLoader::loadAtlasImage(TextureAtlas* atlas, const std::string& filename, glm::vec4* uvTransform)
+{
+	Job job = { NULL, new Texture2D(), filename, false, false, NULL, 0, atlas, uvTransform };
+	submit(job);
+}
+
+//-----------------------------------------------------------------------------
+// Hands a job to the workers
+//-----------------------------------------------------------------------------
+void AssetLoader::submit(const Job& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(job);
+		mPending++;
+	}
+	mJobReady.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Worker thread: runs the CPU half of each job and queues it for upload,
+// waiting while the upload queue is full
+//-----------------------------------------------------------------------------
+void AssetLoader::workerLoop()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobReady.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+			if (mStopping)
+				return;
+
+			job = mJobs.front();
+			mJobs.pop_front();
+		}
+
+		if (job.mesh != NULL)
+			job.prepared = job.mesh->prepareOBJ(job.filename, job.flag);
+		else
+			job.prepared = job.texture->decode(job.filename);
+
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mUploadSpace.wait(lock, [this] { return mStopping || mUploads.size() < MAX_PENDING_UPLOADS; });
+			if (mStopping)
+			{
+				release(job);
+				return;
+			}
+
+			mUploads.push_back(job);
+		}
+		mUploadReady.notify_one();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// GL half of a job
+//-----------------------------------------------------------------------------
+void AssetLoader::upload(const Job& job)
+{
+	// A mesh or texture whose CPU half failed still goes through upload(),
+	// which finds nothing staged and marks it failed
+	bool uploaded = false;
+	if (job.array != NULL)
+		uploaded = job.prepared && job.array->setLayer(job.layer, *job.texture);
+	else if (job.atlas != NULL)
+		uploaded = job.prepared && job.atlas->add(*job.texture, *job.uvTransform);
+	else if (job.mesh != NULL)
+		uploaded = job.mesh->upload() && job.prepared;
+	else
+		uploaded = job.texture->upload(job.flag) && job.prepared;
+	release(job);
+
+	if (!uploaded)
+		std::cerr << "Failed to load " << job.filename << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Frees what a job owns: the staging image of a texture array layer or
+// atlas image
+//-----------------------------------------------------------------------------
+void AssetLoader::release(const Job& job)
+{
+	if (job.array != NULL || job.atlas != NULL)
+		delete job.texture;
+}
+
+//-----------------------------------------------------------------------------
+// Uploads ready assets until the time budget runs out.  The GL work of a
+// single asset can't be split, so one large asset may exceed the budget.
+//-----------------------------------------------------------------------------
+size_t AssetLoader::processUploads(double budgetSeconds)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	size_t uploaded = 0;
+	for (;;)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mUploads.empty())
+				break;
+
+			job = mUploads.front();
+			mUploads.pop_front();
+		}
+		mUploadSpace.notify_one();
+
+		upload(job);
+		uploaded++;
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mPending--;
+		}
+
+		if (std::chrono::duration<double>(Clock::now() - start).count() >= budgetSeconds)
+			break;
+	}
+	return uploaded;
+}
+
+//-----------------------------------------------------------------------------
+// Uploads everything requested so far, waiting for the workers as needed
+//-----------------------------------------------------------------------------
+void AssetLoader::finish()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mUploadReady.wait(lock, [this] { return mPending == 0 || !mUploads.empty(); });
+			if (mPending == 0)
+				return;
+		}
+		processUploads(0.0);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Number of assets requested but not uploaded
+//-----------------------------------------------------------------------------
+size_t AssetLoader::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mPending;
+}
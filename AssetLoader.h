@@ -0,0 +1,95 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Mesh.h"
+#include "Texture2D.h"
+#include "TextureArray.h"
+#include "TextureAtlas.h"
+
+
+// Decoded assets allowed to wait for upload; workers stall beyond this,
+// which bounds the memory held by decoded but not yet uploaded assets
+const size_t MAX_PENDING_UPLOADS = 4;
+
+//--------------------------------------------------------------
+// Asset Loader
+//
+// Loads meshes and textures in two halves.  A pool of worker
+// threads does the file reading, OBJ parsing and image decoding
+// (Mesh::prepareOBJ, Texture2D::decode); the results wait in a
+// bounded queue until the render thread, which owns the GL
+// context, creates the GL objects in processUploads().
+//
+// The loader only stores pointers: each Mesh / Texture2D /
+// TextureArray / TextureAtlas (and atlas uv transform) must
+// outlive it and must not be touched until isLoaded() /
+// isLayerLoaded() says so, or the uv transform is written.
+//--------------------------------------------------------------
+class AssetLoader
+{
+public:
+
+	AssetLoader(unsigned int threadCount = 0);
+	~AssetLoader();
+
+	void loadMesh(Mesh* mesh, const std::string& filename, bool optimize = false);
+	void loadTexture(Texture2D* texture, const std::string& filename, bool generateMipMaps = true);
+
+	// Decodes into a staging Texture2D, then copies it into the layer (TextureArray::setLayer)
+	void loadTextureLayer(TextureArray* array, GLint layer, const std::string& filename);
+
+	// Decodes into a staging Texture2D, then adds it to the atlas (TextureAtlas::add),
+	// which writes uvTransform on the render thread
+	void loadAtlasImage(TextureAtlas* atlas, const std::string& filename, glm::vec4* uvTransform);
+
+	// Render thread: uploads ready assets for up to budgetSeconds (at least one
+	// if any is ready); returns how many were uploaded
+	size_t processUploads(double budgetSeconds);
+
+	// Render thread: waits for and uploads everything requested so far
+	void finish();
+
+	// Requested assets not uploaded yet
+	size_t getPendingCount() const;
+
+private:
+	AssetLoader(const AssetLoader& rhs);
+	AssetLoader& operator = (const AssetLoader& rhs);
+
+	struct Job
+	{
+		Mesh* mesh;
+		Texture2D* texture;
+		std::string filename;
+		bool flag;		// optimize / generateMipMaps
+		bool prepared;	// the worker half succeeded
+		TextureArray* array;	// texture is a staging image owned by the job
+		GLint layer;
+		TextureAtlas* atlas;	// texture is a staging image owned by the job too
+		glm::vec4* uvTransform;
+	};
+
+	void submit(const Job& job);
+	void workerLoop();
+	void upload(const Job& job);
+	static void release(const Job& job);
+
+	std::vector<std::thread> mWorkers;
+	std::deque<Job> mJobs;
+	std::deque<Job> mUploads;
+	size_t mPending;
+	bool mStopping;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mJobReady;		// workers wait for jobs
+	std::condition_variable mUploadSpace;	// workers wait for room in mUploads
+	std::condition_variable mUploadReady;	// finish() waits for uploads
+};
+#endif //ASSETLOADER_H
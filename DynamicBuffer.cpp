@@ -0,0 +1,204 @@
+#include "DynamicBuffer.h"
+#include <iostream>
+#include <cstring>
+
+
+// How long beginFrame() waits per glClientWaitSync call
+const GLuint64 FENCE_WAIT_NANOSECONDS = 1000000;
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+DynamicBuffer::DynamicBuffer()
+	: mBuffer(0),
+	mFrameBytes(0),
+	mFrameCount(0),
+	mRegion(0),
+	mHead(0),
+	mPersistent(false),
+	mUniformAlignment(256),
+	mMemory(NULL),
+	mMappedOffset(0),
+	mStalls(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+DynamicBuffer::~DynamicBuffer()
+{
+	destroy();
+}
+
+//-----------------------------------------------------------------------------
+// Allocates frameCount regions of frameBytes
+//-----------------------------------------------------------------------------
+bool DynamicBuffer::create(GLsizeiptr frameBytes, GLuint frameCount)
+{
+	destroy();
+
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mUniformAlignment = (alignment > 0) ? alignment : 256;
+
+	// Regions start aligned for anything bound from them
+	mFrameBytes = (frameBytes + mUniformAlignment - 1) / mUniformAlignment * mUniformAlignment;
+	mFrameCount = (frameCount > 0) ? frameCount : 1;
+	mPersistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+	GLsizeiptr totalBytes = mFrameBytes * mFrameCount;
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+	if (mPersistent)
+	{
+		GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, totalBytes, NULL, access);
+		mMemory = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalBytes, access);
+	}
+	else
+		glBufferData(GL_COPY_WRITE_BUFFER, totalBytes, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (mBuffer == 0 || (mPersistent && mMemory == NULL))
+	{
+		std::cerr << "Unable to create dynamic buffer!" << std::endl;
+		destroy();
+		return false;
+	}
+
+	mFences.assign(mFrameCount, (GLsync)0);
+	mRegion = 0;
+	mHead = 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Releases the buffer and its fences
+//-----------------------------------------------------------------------------
+void DynamicBuffer::destroy()
+{
+	for (size_t i = 0; i < mFences.size(); i++)
+	{
+		if (mFences[i] != 0)
+			glDeleteSync(mFences[i]);
+	}
+	mFences.clear();
+
+	if (mMemory != NULL)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mMemory = NULL;
+	}
+	glDeleteBuffers(1, &mBuffer);
+	mBuffer = 0;
+	mFrameBytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Waits for the GPU to be done with the region written frameCount frames ago
+//-----------------------------------------------------------------------------
+void DynamicBuffer::beginFrame()
+{
+	mHead = 0;
+	if (mFences.empty() || mFences[mRegion] == 0)
+		return;
+
+	GLsync fence = mFences[mRegion];
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		mStalls++;
+		do
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NANOSECONDS);
+		while (status == GL_TIMEOUT_EXPIRED);
+	}
+	if (status == GL_WAIT_FAILED)
+		std::cerr << "Dynamic buffer fence wait failed" << std::endl;
+
+	glDeleteSync(fence);
+	mFences[mRegion] = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Hands out the next aligned piece of the current region
+//-----------------------------------------------------------------------------
+bool DynamicBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment, DynamicSlice& slice)
+{
+	if (alignment <= 0)
+		alignment = 1;
+
+	GLsizeiptr offset = (mHead + alignment - 1) / alignment * alignment;
+	if (mBuffer == 0 || size <= 0 || offset + size > mFrameBytes)
+		return false;
+
+	GLintptr regionStart = (GLintptr)mRegion * mFrameBytes;
+	unsigned char* data = NULL;
+	if (mPersistent)
+		data = mMemory + regionStart + offset;
+	else
+	{
+		// The region's fence has passed and nothing reads the rest of it yet
+		if (mMemory == NULL)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+			mMemory = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, regionStart + offset, mFrameBytes - offset,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			if (mMemory == NULL)
+				return false;
+			mMappedOffset = offset;
+		}
+		data = mMemory + (offset - mMappedOffset);
+	}
+
+	slice.buffer = mBuffer;
+	slice.offset = regionStart + offset;
+	slice.size = size;
+	slice.data = data;
+	mHead = offset + size;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Allocates a slice and copies data into it
+//-----------------------------------------------------------------------------
+bool DynamicBuffer::write(const void* data, GLsizeiptr size, GLsizeiptr alignment, DynamicSlice& slice)
+{
+	if (!allocate(size, alignment, slice))
+		return false;
+
+	memcpy(slice.data, data, size);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Fallback: unmaps what allocate() mapped.  Coherent persistent writes are
+// seen by the next GL commands as they are.
+//-----------------------------------------------------------------------------
+void DynamicBuffer::flush()
+{
+	if (mPersistent || mMemory == NULL)
+		return;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	mMemory = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Fences the current region and moves to the next
+//-----------------------------------------------------------------------------
+void DynamicBuffer::endFrame()
+{
+	if (mBuffer == 0)
+		return;
+
+	flush();
+	mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mRegion = (mRegion + 1) % mFrameCount;
+	mHead = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef DYNAMICBUFFER_H
+#define DYNAMICBUFFER_H
+
+#include <vector>
+
+#include "GL/glew.h"
+
+
+// Frames the CPU may run ahead of the GPU, one region of the buffer each
+const GLuint DYNAMIC_BUFFER_FRAMES = 3;
+
+// Part of the current frame's region handed out by DynamicBuffer::allocate;
+// write through data, then bind buffer at offset
+struct DynamicSlice
+{
+	GLuint buffer;
+	GLintptr offset;
+	GLsizeiptr size;
+	void* data;
+};
+
+//--------------------------------------------------------------
+// Dynamic Buffer
+//
+// One buffer object split into frameCount regions that are
+// filled in turn, for data rewritten every frame: uniform
+// block contents, instance transforms, per-draw data and
+// indirect commands.  allocate() hands out aligned slices of
+// the current region with a pointer to write them through, so
+// nothing is copied by glBufferSubData and no buffer is
+// orphaned.  A fence at endFrame() guards each region; by the
+// time beginFrame() comes back to it the GPU is normally done,
+// and only then does the CPU wait.
+//
+// With GL 4.4 / ARB_buffer_storage the buffer stays mapped
+// (persistent, coherent).  Otherwise the rest of the region is
+// mapped unsynchronized on the first allocate() and unmapped by
+// flush(), which must come between writing slices and the GL
+// calls that read them (it does nothing when mapped for good).
+//--------------------------------------------------------------
+class DynamicBuffer
+{
+public:
+	DynamicBuffer();
+	~DynamicBuffer();
+
+	bool create(GLsizeiptr frameBytes, GLuint frameCount = DYNAMIC_BUFFER_FRAMES);
+	void destroy();
+
+	// Starts writing the next region, waiting if the GPU still reads it
+	void beginFrame();
+
+	// A slice of size bytes at a multiple of alignment; false when the region is full
+	bool allocate(GLsizeiptr size, GLsizeiptr alignment, DynamicSlice& slice);
+
+	// allocate + copy
+	bool write(const void* data, GLsizeiptr size, GLsizeiptr alignment, DynamicSlice& slice);
+
+	// Makes the slices written so far readable by GL
+	void flush();
+
+	// Fences the region after the frame's last use of it
+	void endFrame();
+
+	GLuint getBuffer() const { return mBuffer; }
+	bool isPersistent() const { return mPersistent; }
+	GLsizeiptr getFrameBytes() const { return mFrameBytes; }
+	GLsizeiptr getUsedBytes() const { return mHead; }
+
+	// glBindBufferRange alignment of uniform block slices
+	GLsizeiptr getUniformAlignment() const { return mUniformAlignment; }
+
+	// Frames whose beginFrame() had to wait for the GPU
+	unsigned int getStallCount() const { return mStalls; }
+
+private:
+	DynamicBuffer(const DynamicBuffer& rhs);
+	DynamicBuffer& operator = (const DynamicBuffer& rhs);
+
+	GLuint mBuffer;
+	GLsizeiptr mFrameBytes;
+	GLuint mFrameCount;
+	GLuint mRegion;				// region being written
+	GLsizeiptr mHead;			// next free byte in it
+	bool mPersistent;
+	GLsizeiptr mUniformAlignment;
+
+	// Persistent: the whole buffer.  Fallback: the mapped part of the
+	// region, starting at mMappedOffset, NULL while unmapped.
+	unsigned char* mMemory;
+	GLsizeiptr mMappedOffset;
+
+	std::vector<GLsync> mFences;
+	unsigned int mStalls;
+};
+#endif //DYNAMICBUFFER_H
@@ -0,0 +1,170 @@
+#include "Frustum.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Clears the batch
+//-----------------------------------------------------------------------------
+void CullingBatch::clear()
+{
+	sphereX.clear(); sphereY.clear(); sphereZ.clear(); radius.clear();
+	boxX.clear(); boxY.clear(); boxZ.clear();
+	extentX.clear(); extentY.clear(); extentZ.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Adds an object given its object space bounds and model matrix.  The box is
+// the world space box around the transformed one; the sphere is scaled by the
+// largest axis scale.
+//-----------------------------------------------------------------------------
+void CullingBatch::add(const MeshBounds& bounds, const glm::mat4& model)
+{
+	glm::mat3 linear(model);
+	glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+	float scale = glm::max(glm::length(linear[0]), glm::max(glm::length(linear[1]), glm::length(linear[2])));
+
+	glm::vec3 sphereCenter = glm::vec3(model * glm::vec4(bounds.sphereCenter, 1.0f));
+	glm::vec3 boxCenter = glm::vec3(model * glm::vec4(0.5f * (bounds.boxMin + bounds.boxMax), 1.0f));
+	glm::vec3 extent = absLinear * (0.5f * (bounds.boxMax - bounds.boxMin));
+
+	sphereX.push_back(sphereCenter.x);
+	sphereY.push_back(sphereCenter.y);
+	sphereZ.push_back(sphereCenter.z);
+	radius.push_back(bounds.sphereRadius * scale);
+	boxX.push_back(boxCenter.x);
+	boxY.push_back(boxCenter.y);
+	boxZ.push_back(boxCenter.z);
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+Frustum::Frustum()
+{
+	update(glm::mat4());
+}
+
+//-----------------------------------------------------------------------------
+// Extracts the planes from the rows of a view-projection matrix
+//-----------------------------------------------------------------------------
+void Frustum::update(const glm::mat4& viewProjection)
+{
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	mPlanes[0] = row[3] + row[0];	// left
+	mPlanes[1] = row[3] - row[0];	// right
+	mPlanes[2] = row[3] + row[1];	// bottom
+	mPlanes[3] = row[3] - row[1];	// top
+	mPlanes[4] = row[3] + row[2];	// near
+	mPlanes[5] = row[3] - row[2];	// far
+
+	for (int i = 0; i < 6; i++)
+		mPlanes[i] /= glm::length(glm::vec3(mPlanes[i]));
+}
+
+//-----------------------------------------------------------------------------
+// Returns false if the sphere is completely outside
+//-----------------------------------------------------------------------------
+bool Frustum::testSphere(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(mPlanes[i]), center) + mPlanes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Returns false if the box (center and half extents) is completely outside
+//-----------------------------------------------------------------------------
+bool Frustum::testBox(const glm::vec3& center, const glm::vec3& extent) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec3 normal(mPlanes[i]);
+		if (glm::dot(normal, center) + mPlanes[i].w + glm::dot(glm::abs(normal), extent) < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Tests every object of the batch against the six planes, sphere first and
+// then box.  With SSE four objects go through each plane at once.
+//-----------------------------------------------------------------------------
+size_t Frustum::cull(const CullingBatch& batch, std::vector<unsigned char>& visible) const
+{
+	size_t count = batch.size();
+	visible.resize(count);
+
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#ifdef FRUSTUM_SSE
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sx = _mm_loadu_ps(&batch.sphereX[i]);
+		__m128 sy = _mm_loadu_ps(&batch.sphereY[i]);
+		__m128 sz = _mm_loadu_ps(&batch.sphereZ[i]);
+		__m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&batch.radius[i]), signMask);
+		__m128 bx = _mm_loadu_ps(&batch.boxX[i]);
+		__m128 by = _mm_loadu_ps(&batch.boxY[i]);
+		__m128 bz = _mm_loadu_ps(&batch.boxZ[i]);
+		__m128 ex = _mm_loadu_ps(&batch.extentX[i]);
+		__m128 ey = _mm_loadu_ps(&batch.extentY[i]);
+		__m128 ez = _mm_loadu_ps(&batch.extentZ[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 nx = _mm_set1_ps(mPlanes[p].x);
+			__m128 ny = _mm_set1_ps(mPlanes[p].y);
+			__m128 nz = _mm_set1_ps(mPlanes[p].z);
+			__m128 d = _mm_set1_ps(mPlanes[p].w);
+
+			// Sphere: center distance below -radius
+			__m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, sx), _mm_mul_ps(ny, sy)),
+				_mm_add_ps(_mm_mul_ps(nz, sz), d));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(sphereDistance, negRadius));
+
+			// Box: even the corner furthest along the normal is behind the plane
+			__m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, bx), _mm_mul_ps(ny, by)),
+				_mm_add_ps(_mm_mul_ps(nz, bz), d));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+				_mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)), _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(boxDistance, reach), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (int k = 0; k < 4; k++)
+		{
+			visible[i + k] = (mask & (1 << k)) ? 0 : 1;
+			visibleCount += visible[i + k];
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		glm::vec3 sphere(batch.sphereX[i], batch.sphereY[i], batch.sphereZ[i]);
+		glm::vec3 box(batch.boxX[i], batch.boxY[i], batch.boxZ[i]);
+		glm::vec3 extent(batch.extentX[i], batch.extentY[i], batch.extentZ[i]);
+		visible[i] = (testSphere(sphere, batch.radius[i]) && testBox(box, extent)) ? 1 : 0;
+		visibleCount += visible[i];
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,49 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+
+//--------------------------------------------------------------
+// World space bounds of the objects to cull, one array per
+// component so the frustum tests four objects at a time
+//--------------------------------------------------------------
+struct CullingBatch
+{
+	std::vector<float> sphereX, sphereY, sphereZ, radius;
+	std::vector<float> boxX, boxY, boxZ;
+	std::vector<float> extentX, extentY, extentZ;	// box half extents
+
+	void clear();
+	void add(const MeshBounds& bounds, const glm::mat4& model);
+	size_t size() const { return radius.size(); }
+};
+
+//--------------------------------------------------------------
+// View Frustum
+//
+// The six planes of a view-projection matrix (Gribb & Hartmann),
+// normals pointing inwards.  An object is culled when its sphere
+// or its box lies completely behind one of them.
+//--------------------------------------------------------------
+class Frustum
+{
+public:
+	Frustum();
+
+	void update(const glm::mat4& viewProjection);
+
+	bool testSphere(const glm::vec3& center, float radius) const;
+	bool testBox(const glm::vec3& center, const glm::vec3& extent) const;
+
+	// Sets visible[i] to 1 for every object of the batch inside the frustum
+	// and 0 for the rest; returns how many are visible
+	size_t cull(const CullingBatch& batch, std::vector<unsigned char>& visible) const;
+
+private:
+	glm::vec4 mPlanes[6];
+};
+#endif //FRUSTUM_H
@@ -0,0 +1,180 @@
+#include "GLState.h"
+
+
+// A new context has no textures bound; the rest is treated as unknown
+// until first set
+GLuint GLState::mProgram = GLState::UNKNOWN;
+GLuint GLState::mVertexArray = GLState::UNKNOWN;
+GLuint GLState::mActiveUnit = GLState::UNKNOWN;
+GLuint GLState::mTextures[GLState::MAX_TEXTURE_UNITS][GLState::NUM_TEXTURE_TARGETS] = {};
+GLenum GLState::mPolygonMode = GLState::UNKNOWN;
+GLStateStats GLState::mStats = { 0, 0 };
+
+//-----------------------------------------------------------------------------
+// Slot of a texture target in the per-unit cache, -1 for targets not cached
+//-----------------------------------------------------------------------------
+int GLState::getTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	case GL_TEXTURE_BUFFER: return 2;
+	default: return -1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Makes a program current
+//-----------------------------------------------------------------------------
+void GLState::useProgram(GLuint program)
+{
+	if (program == mProgram)
+	{
+		mStats.skipped++;
+		return;
+	}
+
+	glUseProgram(program);
+	mProgram = program;
+	mStats.issued++;
+}
+
+//-----------------------------------------------------------------------------
+// Binds a vertex array object
+//-----------------------------------------------------------------------------
+void GLState::bindVertexArray(GLuint vao)
+{
+	if (vao == mVertexArray)
+	{
+		mStats.skipped++;
+		return;
+	}
+
+	glBindVertexArray(vao);
+	mVertexArray = vao;
+	mStats.issued++;
+}
+
+//-----------------------------------------------------------------------------
+// Selects the active texture unit
+//-----------------------------------------------------------------------------
+void GLState::activeTexture(GLuint unit)
+{
+	if (unit == mActiveUnit)
+	{
+		mStats.skipped++;
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	mActiveUnit = unit;
+	mStats.issued++;
+}
+
+//-----------------------------------------------------------------------------
+// Binds a texture to a unit, switching the active unit only if the binding
+// changes
+//-----------------------------------------------------------------------------
+void GLState::bindTexture(GLenum target, GLuint unit, GLuint texture)
+{
+	int index = getTargetIndex(target);
+	if (index >= 0 && unit < MAX_TEXTURE_UNITS)
+	{
+		if (mTextures[unit][index] == texture)
+		{
+			mStats.skipped++;
+			return;
+		}
+		mTextures[unit][index] = texture;
+	}
+
+	activeTexture(unit);
+	glBindTexture(target, texture);
+	mStats.issued++;
+}
+
+//-----------------------------------------------------------------------------
+// Sets the polygon mode of front and back faces
+//-----------------------------------------------------------------------------
+void GLState::polygonMode(GLenum mode)
+{
+	if (mode == mPolygonMode)
+	{
+		mStats.skipped++;
+		return;
+	}
+
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	mPolygonMode = mode;
+	mStats.issued++;
+}
+
+//-----------------------------------------------------------------------------
+// Deletes a program; GL unbinds it if current, and so does the cache
+//-----------------------------------------------------------------------------
+void GLState::deleteProgram(GLuint program)
+{
+	if (program == 0) return;
+
+	glDeleteProgram(program);
+	if (program == mProgram)
+		mProgram = UNKNOWN;
+}
+
+//-----------------------------------------------------------------------------
+// Deletes a vertex array object
+//-----------------------------------------------------------------------------
+void GLState::deleteVertexArray(GLuint vao)
+{
+	if (vao == 0) return;
+
+	glDeleteVertexArrays(1, &vao);
+	if (vao == mVertexArray)
+		mVertexArray = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Deletes a texture, which GL unbinds from every unit
+//-----------------------------------------------------------------------------
+void GLState::deleteTexture(GLuint texture)
+{
+	if (texture == 0) return;
+
+	glDeleteTextures(1, &texture);
+
+	for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		for (GLuint target = 0; target < NUM_TEXTURE_TARGETS; target++)
+		{
+			if (mTextures[unit][target] == texture)
+				mTextures[unit][target] = 0;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Marks every cached value unknown so the next request always reaches GL
+//-----------------------------------------------------------------------------
+void GLState::invalidate()
+{
+	mProgram = UNKNOWN;
+	mVertexArray = UNKNOWN;
+	mActiveUnit = UNKNOWN;
+	mPolygonMode = UNKNOWN;
+
+	for (GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		for (GLuint target = 0; target < NUM_TEXTURE_TARGETS; target++)
+			mTextures[unit][target] = UNKNOWN;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Resets the counters, e.g. once per frame
+//-----------------------------------------------------------------------------
+void GLState::resetStats()
+{
+	mStats.issued = 0;
+	mStats.skipped = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include "GL/glew.h"
+
+
+// How many state changes went to the driver and how many were skipped
+struct GLStateStats
+{
+	unsigned int issued;
+	unsigned int skipped;
+};
+
+//--------------------------------------------------------------
+// GL State Cache
+//
+// Remembers the bound program, vertex array, active texture unit,
+// textures per unit and polygon mode, and only calls GL when a
+// request actually changes one of them.  Every bind of these must
+// go through here (or be followed by invalidate()), otherwise the
+// cache goes stale.  Objects must be deleted through here too, so
+// a reused name isn't mistaken for one still bound.
+//--------------------------------------------------------------
+class GLState
+{
+public:
+
+	static const GLuint MAX_TEXTURE_UNITS = 16;
+
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vao);
+	static void activeTexture(GLuint unit);
+	static void bindTexture(GLenum target, GLuint unit, GLuint texture);
+	static void polygonMode(GLenum mode);
+
+	static void deleteProgram(GLuint program);
+	static void deleteVertexArray(GLuint vao);
+	static void deleteTexture(GLuint texture);
+
+	// Forget everything, e.g. after code that binds GL objects directly
+	static void invalidate();
+
+	static const GLStateStats& getStats() { return mStats; }
+	static void resetStats();
+
+private:
+
+	static int getTargetIndex(GLenum target);
+
+	static const GLuint NUM_TEXTURE_TARGETS = 3;	// 2D, 2D array, buffer
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	static GLuint mProgram;
+	static GLuint mVertexArray;
+	static GLuint mActiveUnit;
+	static GLuint mTextures[MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+	static GLenum mPolygonMode;
+	static GLStateStats mStats;
+};
+#endif //GLSTATE_H
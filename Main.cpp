@@ -6,6 +6,8 @@ Amanda Grams e Paula Knob
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <map>
+#include <memory>
 #define GLEW_STATIC
 #include "GL/glew.h"	// Importante - este cabealho deve vir antes do cabealho glfw3
 #include "GLFW/glfw3.h"
@@ -16,6 +18,17 @@ Amanda Grams e Paula Knob
 #include "Texture2D.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "Frustum.h"
+#include "UniformBuffer.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "MeshArena.h"
+#include "AssetLoader.h"
+#include "ResourceManager.h"
+#include "TextureArray.h"
+#include "TextureAtlas.h"
+#include "TextureStreamer.h"
+#include "DynamicBuffer.h"
 
 
 //Variveis globais
@@ -27,12 +40,107 @@ bool gWireframe = false;
 glm::vec4 gClearColor(0.23f, 0.38f, 0.47f, 1.0f);
 const GLubyte* renderer;
 const GLubyte* version;
+size_t gVisibleObjects = 0;
+size_t gTotalObjects = 0;
 
 //Configuraes da Cmera
 FPSCamera fpsCamera(glm::vec3(0.0f, 2.0f, 10.0f));
 const double ZOOM_SENSITIVITY = -3.0;
 const float MOVE_SPEED = 5.0; // units per second
 const float MOUSE_SENSITIVITY = 0.1f;
+const float FAR_PLANE = 200.0f;
+
+// Tempo por quadro para criar no OpenGL os recursos j carregados pelas threads
+const double UPLOAD_BUDGET = 0.002;
+
+// Unidade de textura dos dados por desenho do arena (a difusa fica na 0)
+const GLuint DRAW_DATA_TEXTURE_UNIT = 1;
+
+// Texturas dos objetos da cena agrupadas para dividirem o binding (e a chamada de
+// desenho do arena): as pequenas, com uvs em 0..1, num atlas; as de mesmo tamanho
+// num texture array por tamanho, na unidade 2; as demais com streaming. Nenhuma
+// imagem  redimensionada.
+const bool PACK_SCENE_TEXTURES = true;
+const int SCENE_ATLAS_IMAGE_SIZE = 384;
+const GLuint DIFFUSE_ARRAY_TEXTURE_UNIT = 2;
+
+// Memria de vdeo das texturas com streaming: comeam pelos nveis de at 64x64
+// e recebem os mais finos conforme o tamanho na tela, dentro deste limite
+const size_t TEXTURE_BUDGET = 64 * 1024 * 1024;
+
+// Dados reescritos a cada quadro (bloco FrameData, matrizes das instncias, dados
+// por desenho do arena) vo num buffer mapeado com uma regio por quadro em voo
+const GLsizeiptr DYNAMIC_FRAME_BYTES = 1024 * 1024;
+
+// Grade de barris desenhada com instancing
+const int BARREL_ROWS = 20;
+const int BARREL_COLUMNS = 20;
+
+// Bloco FrameData dos shaders (std140): cmera e luz, enviado uma vez por quadro
+struct FrameBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 viewPos;			// vec3 + padding
+	glm::vec4 lightPosition;
+	glm::vec4 lightAmbient;
+	glm::vec4 lightDiffuse;
+	glm::vec4 lightSpecular;
+};
+
+// Bloco MaterialData dos shaders (std140), um slot do buffer por material
+struct MaterialBlock
+{
+	glm::vec3 ambient;
+	float padding;
+	glm::vec3 specular;
+	float shininess;
+};
+
+// Uniformes do shader dos objetos que mudam por objeto, resolvidos uma vez depois do link
+struct SceneUniforms
+{
+	UniformHandle<glm::mat4> model;
+	UniformHandle<glm::vec3> posOffset, posScale;
+	UniformHandle<glm::vec2> uvOffset, uvScale;
+	UniformHandle<GLint> octNormals;
+	UniformHandle<GLint> diffuseLayer;
+};
+
+// Programas de shader da cena, na ordem em que entram na chave de ordenao
+enum SceneProgram
+{
+	PROGRAM_BASIC,
+	PROGRAM_INSTANCED,
+	PROGRAM_BATCHED,		// malhas do arena, vrias por chamada de desenho
+	NUM_SCENE_PROGRAMS
+};
+
+// Onde fica a textura difusa de um objeto: uma textura prpria, a camada de um
+// texture array ou uma regio do atlas
+struct SceneTexture
+{
+	TextureHandle texture;
+	TextureArray* array;
+	GLint layer;				// -1: fora de array
+	TextureAtlas* atlas;
+	glm::vec4 uvTransform;		// regio das uvs; no atlas fica zerada at a imagem chegar
+	int binding;				// mesmo valor: mesmo binding de textura (chave de ordenao)
+
+	SceneTexture() : array(NULL), layer(-1), atlas(NULL), uvTransform(0.0f, 0.0f, 1.0f, 1.0f), binding(0) {}
+};
+
+// Um desenho enviado  fila de renderizao
+struct DrawItem
+{
+	Mesh* mesh;
+	const SceneTexture* texture;
+	SceneProgram program;
+	int material;
+	GLuint lod;
+	glm::mat4 model;							// s desenhos no instanciados
+	const std::vector<glm::mat4>* instances;	// s desenhos instanciados
+};
 
 // Declarao de Funes
 void glfw_onKey(GLFWwindow* window, int key, int scancode, int action, int mode);
@@ -40,6 +148,11 @@ void glfw_onFramebufferSize(GLFWwindow* window, int width, int height);
 void glfw_onMouseScroll(GLFWwindow* window, double deltaX, double deltaY);
 void update(double elapsedTime);
 void showFPS(GLFWwindow* window);
+float getScreenSize(const CullingBatch& batch, size_t object, const glm::vec3& viewPos);
+SceneUniforms getSceneUniforms(ShaderProgram& shader, bool instanced);
+void setMeshUniforms(ShaderProgram& shader, const SceneUniforms& uniforms, const Mesh& mesh, const glm::vec4& uvTransform);
+bool isSceneTextureLoaded(const SceneTexture& texture);
+void bindSceneTexture(const SceneTexture& texture);
 bool initOpenGL();
 
 //-----------------------------------------------------------------------------
@@ -61,30 +174,183 @@ int main()
 	ShaderProgram lightShader;
 	lightShader.loadShaders("shaders/bulb.vert", "shaders/bulb.frag");
 
+	ShaderProgram instancedShader;
+	instancedShader.loadShaders("shaders/basic_instanced.vert", "shaders/basic.frag");
+
+	ShaderProgram batchedShader;
+	batchedShader.loadShaders("shaders/basic_batched.vert", "shaders/basic.frag");
+
+	// Handles dos uniformes: nenhuma busca por nome dentro do loop de renderizao
+	SceneUniforms sceneUniforms = getSceneUniforms(shaderProgram, false);
+	SceneUniforms instancedUniforms = getSceneUniforms(instancedShader, true);
+
+	UniformHandle<glm::vec3> lightColorUniform = lightShader.getUniformHandle<glm::vec3>("lightColor");
+	UniformHandle<glm::mat4> lightModelUniform = lightShader.getUniformHandle<glm::mat4>("model");
+	UniformHandle<glm::vec3> lightPosOffsetUniform = lightShader.getUniformHandle<glm::vec3>("posOffset");
+	UniformHandle<glm::vec3> lightPosScaleUniform = lightShader.getUniformHandle<glm::vec3>("posScale");
+
+	// Blocos de uniformes: os trs programas leem cmera e luz do mesmo buffer
+	ShaderProgram* programs[] = { &shaderProgram, &instancedShader, &batchedShader, &lightShader };
+	for (int i = 0; i < 4; i++)
+	{
+		programs[i]->bindUniformBlock("FrameData", FRAME_BLOCK_BINDING);
+		programs[i]->bindUniformBlock("MaterialData", MATERIAL_BLOCK_BINDING);
+	}
+
+	// O sampler da textura difusa fica sempre na unidade 0 e o do texture array na 2
+	// (samplers de tipos diferentes no podem dividir uma unidade)
+	for (int i = 0; i < 3; i++)
+	{
+		programs[i]->use();
+		programs[i]->setUniform(programs[i]->getUniformHandle<GLint>("diffuseMap"), 0);
+		programs[i]->setUniform(programs[i]->getUniformHandle<GLint>("diffuseArray"), (GLint)DIFFUSE_ARRAY_TEXTURE_UNIT);
+	}
+	batchedShader.use();
+	batchedShader.setUniform(batchedShader.getUniformHandle<GLint>("drawData"), (GLint)DRAW_DATA_TEXTURE_UNIT);
+
+	UniformBuffer frameBuffer;
+	frameBuffer.create(sizeof(FrameBlock));
+	frameBuffer.bind(FRAME_BLOCK_BINDING);
+
+	// Dados por quadro; sem ele (ou com a regio cheia) cada um volta ao seu prprio buffer
+	DynamicBuffer dynamicBuffer;
+	dynamicBuffer.create(DYNAMIC_FRAME_BYTES);
+
 	// Carregar mesh e texturas
 	const int numModels = 6;
-	Mesh mesh[numModels];
-	Texture2D texture[numModels];
+	MeshHandle mesh[numModels];
+	SceneTexture texture[numModels];
+	TextureAtlas sceneAtlas;
+	std::vector<std::unique_ptr<TextureArray> > sceneArrays;
+
+	// Malhas estticas da cena num s buffer de vrtices e de ndices (cresce se precisar)
+	MeshArena meshArena;
+	meshArena.create(VERTEX_FORMAT_SNORM16, 0x10000, 0x40000);
+	meshArena.setDynamicBuffer(&dynamicBuffer);
+
+	// Normais octadricas dependem s do formato, igual para todo o arena
+	batchedShader.use();
+	batchedShader.setUniform(batchedShader.getUniformHandle<GLint>("octNormals"),
+		meshArena.getVertexFormat() == VERTEX_FORMAT_SNORM16 ? 1 : 0);
+
+	// Cada arquivo  carregado uma vez s: pedidos repetidos (pelo caminho ou pelo
+	// contedo) recebem o mesmo handle e dividem os buffers e texturas da GPU
+	ResourceManager resources;
+
+	// Nveis de mipmap lidos numa thread prpria e enviados no incio do quadro
+	TextureStreamer textureStreamer(TEXTURE_BUDGET);
+
+	// Parse dos OBJ's e decodificao das imagens em paralelo nas threads do carregador;
+	// o loop de renderizao cria os buffers e texturas aos poucos, e cada objeto
+	// aparece quando sua malha e textura esto prontas. Declarado depois dos recursos
+	// para ser destrudo antes deles.
+	AssetLoader assetLoader;
 
 	// OBJ's que esto sendo carregados na cena
-	mesh[0].loadOBJ("models/crate.obj");
-	mesh[1].loadOBJ("models/woodcrate.obj");
-	mesh[2].loadOBJ("models/robot.obj");
-	mesh[3].loadOBJ("models/floor.obj");
-	mesh[4].loadOBJ("models/bowling_pin.obj");
-	mesh[5].loadOBJ("models/bunny.obj");
-	
+	// Vrtices comprimidos (16 bytes em vez de 32), 4 nveis de detalhe escolhidos
+	// pelo tamanho na tela e otimizados para o cache de vrtices da GPU (o resultado
+	// fica no cache binrio)
+	MeshSettings sceneMeshes(VERTEX_FORMAT_SNORM16, MAX_MESH_LODS, &meshArena, true);
+	mesh[0] = resources.getMesh("models/crate.obj", sceneMeshes, &assetLoader);
+	mesh[1] = resources.getMesh("models/woodcrate.obj", sceneMeshes, &assetLoader);
+	mesh[2] = resources.getMesh("models/robot.obj", sceneMeshes, &assetLoader);
+	mesh[3] = resources.getMesh("models/floor.obj", sceneMeshes, &assetLoader);
+	mesh[4] = resources.getMesh("models/bowling_pin.obj", sceneMeshes, &assetLoader);
+	mesh[5] = resources.getMesh("models/bunny.obj", sceneMeshes, &assetLoader);
+	MeshHandle lightMesh = resources.getMesh("models/light.obj", MeshSettings(), &assetLoader);
+
+	// Um barril desenhado vrias vezes com uma chamada por LOD
+	MeshHandle barrelMesh = resources.getMesh("models/barrel.obj",
+		MeshSettings(VERTEX_FORMAT_SNORM16, MAX_MESH_LODS, NULL, true), &assetLoader);
+
 	// carregando as imagens pra compr as texturas
-	texture[0].loadTexture("textures/crate.jpg", true);
-	texture[1].loadTexture("textures/woodcrate_diffuse.jpg", true);
-	texture[2].loadTexture("textures/robot_diffuse.jpg", true);
-	texture[3].loadTexture("textures/tile_floor.jpg", true);
-	texture[4].loadTexture("textures/AMF.tga", true);
-	texture[5].loadTexture("textures/bunny_diffuse.jpg", true);
-	
+	const char* textureFiles[numModels] = {
+		"textures/crate.jpg",
+		"textures/woodcrate_diffuse.jpg",
+		"textures/robot_diffuse.jpg",
+		"textures/tile_floor.jpg",
+		"textures/AMF.tga",
+		"textures/bunny_diffuse.jpg"
+	};
+	// O piso repete a textura, o que uma regio do atlas no faz
+	const bool textureRepeats[numModels] = { false, false, false, true, false, false };
+
+	// O tamanho lido do cabealho de cada imagem decide onde ela fica; sem ele (ou
+	// sem agrupar) a textura  prpria
+	int textureWidth[numModels], textureHeight[numModels];
+	for (int i = 0; i < numModels; i++)
+	{
+		texture[i].binding = i + 1;
+		if (!PACK_SCENE_TEXTURES || !Texture2D::readSize(textureFiles[i], textureWidth[i], textureHeight[i]))
+			textureWidth[i] = textureHeight[i] = 0;
+	}
+
+	// Atlas de uma prateleira s, do tamanho exato das imagens pequenas
+	GLsizei atlasWidth = 0, atlasHeight = 0;
+	for (int i = 0; i < numModels; i++)
+	{
+		if (textureWidth[i] > 0 && !textureRepeats[i] && std::max(textureWidth[i], textureHeight[i]) <= SCENE_ATLAS_IMAGE_SIZE)
+		{
+			atlasWidth += TextureAtlas::getCellSize(textureWidth[i]);
+			atlasHeight = std::max(atlasHeight, TextureAtlas::getCellSize(textureHeight[i]));
+			texture[i].atlas = &sceneAtlas;
+		}
+	}
+	bool useAtlas = atlasWidth > 0 && sceneAtlas.create(atlasWidth, atlasHeight);
 
-	Mesh lightMesh;
-	lightMesh.loadOBJ("models/light.obj");
+	// As outras, por tamanho exato; um array para cada tamanho com duas ou mais
+	std::map<std::pair<int, int>, std::vector<int> > sizeGroups;
+	for (int i = 0; i < numModels; i++)
+	{
+		if (!useAtlas)
+			texture[i].atlas = NULL;
+		if (texture[i].atlas != NULL)
+		{
+			texture[i].binding = numModels + 2;
+			texture[i].uvTransform = glm::vec4(0.0f);
+		}
+		else if (textureWidth[i] > 0)
+			sizeGroups[std::make_pair(textureWidth[i], textureHeight[i])].push_back(i);
+	}
+	for (std::map<std::pair<int, int>, std::vector<int> >::iterator it = sizeGroups.begin(); it != sizeGroups.end(); ++it)
+	{
+		const std::vector<int>& group = it->second;
+		std::unique_ptr<TextureArray> array(new TextureArray());
+		if (group.size() < 2 || !array->create(it->first.first, it->first.second, (GLsizei)group.size()))
+			continue;
+
+		for (size_t layer = 0; layer < group.size(); layer++)
+		{
+			texture[group[layer]].array = array.get();
+			texture[group[layer]].layer = (GLint)layer;
+			texture[group[layer]].binding = numModels + 3 + (int)sceneArrays.size();
+		}
+		sceneArrays.push_back(std::move(array));
+	}
+
+	for (int i = 0; i < numModels; i++)
+	{
+		if (texture[i].array != NULL)
+			assetLoader.loadTextureLayer(texture[i].array, texture[i].layer, textureFiles[i]);
+		else if (texture[i].atlas != NULL)
+			assetLoader.loadAtlasImage(texture[i].atlas, textureFiles[i], &texture[i].uvTransform);
+		else
+			texture[i].texture = resources.getStreamedTexture(textureFiles[i], textureStreamer);
+	}
+
+	SceneTexture barrelTexture;
+	barrelTexture.texture = resources.getStreamedTexture("textures/barrel_diffuse.png", textureStreamer);
+	barrelTexture.binding = numModels + 1;
+
+	std::vector<glm::mat4> barrelModel;
+	for (int row = 0; row < BARREL_ROWS; row++)
+	{
+		for (int column = 0; column < BARREL_COLUMNS; column++)
+		{
+			glm::vec3 position(2.0f * column - BARREL_COLUMNS + 1.0f, 0.0f, -8.0f - 2.0f * row);
+			barrelModel.push_back(glm::translate(glm::mat4(), position) * glm::scale(glm::mat4(), glm::vec3(0.5f)));
+		}
+	}
 	
 	// Posies do model
 	glm::vec3 modelPos[] = {
@@ -108,14 +374,45 @@ int main()
 		
 	};
 
+	// Materiais, enviados uma vez; cada objeto aponta para um deles
+	const int numMaterials = 1;
+	MaterialBlock materials[numMaterials] = {
+		{ glm::vec3(0.1f, 0.1f, 0.1f), 0.0f, glm::vec3(0.5f, 0.5f, 0.5f), 32.0f }	// padro
+	};
+	int modelMaterial[numModels] = { 0, 0, 0, 0, 0, 0 };
+	int barrelMaterial = 0;
+
+	UniformBuffer materialBuffer;
+	materialBuffer.create(sizeof(MaterialBlock), numMaterials);
+	for (int i = 0; i < numMaterials; i++)
+		materialBuffer.update(&materials[i], i);
+
 	double lastTime = glfwGetTime();
 	float angle = 0.0f;
 
+	// Frustum culling
+	Frustum frustum;
+	CullingBatch cullingBatch;
+	std::vector<unsigned char> visible;
+	glm::mat4 modelMatrix[numModels];
+	std::vector<glm::mat4> barrelInstances[MAX_MESH_LODS];
+
+	// Fila de renderizao ordenada por estado e profundidade
+	ShaderProgram* scenePrograms[NUM_SCENE_PROGRAMS] = { &shaderProgram, &instancedShader, &batchedShader };
+	SceneUniforms* programUniforms[NUM_SCENE_PROGRAMS] = { &sceneUniforms, &instancedUniforms, NULL };
+	RenderQueue renderQueue;
+	std::vector<DrawItem> drawItems;
+
 	// Loop de renderizao
 	while (!glfwWindowShouldClose(gWindow))
 	{
 		//exibio e clculo do tempo decorrido
 		showFPS(gWindow);
+		GLState::resetStats();
+		dynamicBuffer.beginFrame();
+
+		// Recursos que terminaram de carregar
+		assetLoader.processUploads(UPLOAD_BUDGET);
 
 		double currentTime = glfwGetTime();
 		double deltaTime = currentTime - lastTime;
@@ -133,7 +430,7 @@ int main()
 		view = fpsCamera.getViewMatrix();
 
 		// Cria a matriz de projeo
-		projection = glm::perspective(glm::radians(fpsCamera.getFOV()), (float)gWindowWidth / (float)gWindowHeight, 0.1f, 200.0f);
+		projection = glm::perspective(glm::radians(fpsCamera.getFOV()), (float)gWindowWidth / (float)gWindowHeight, 0.1f, FAR_PLANE);
 
 
 		// Atualiza posio de visualizao da camera
@@ -151,47 +448,187 @@ int main()
 		angle += (float)deltaTime * 50.0f;
 		lightPos.x = 8.0f * sinf(glm::radians(angle));
 
-		// Deve ser chamado ANTES de configurar uniformes porque a configurao de uniformes  feita
-		//no programa de shader atualmente ativo.
-		shaderProgram.use();
+		// Cmera e luz simples: um envio para todos os programas
+		FrameBlock frame;
+		frame.view = view;
+		frame.projection = projection;
+		frame.viewPos = glm::vec4(viewPos, 1.0f);
+		frame.lightPosition = glm::vec4(lightPos, 1.0f);
+		frame.lightAmbient = glm::vec4(0.2f, 0.2f, 0.2f, 0.0f);
+		frame.lightDiffuse = glm::vec4(lightColor, 0.0f);
+		frame.lightSpecular = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+		DynamicSlice frameSlice;
+		if (dynamicBuffer.write(&frame, sizeof(frame), dynamicBuffer.getUniformAlignment(), frameSlice))
+		{
+			dynamicBuffer.flush();
+			glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, frameSlice.buffer, frameSlice.offset, frameSlice.size);
+		}
+		else
+		{
+			frameBuffer.update(&frame);
+			frameBuffer.bind(FRAME_BLOCK_BINDING);
+		}
 
+		// Descarta os objetos fora do frustum antes de desenhar. Malhas ainda
+		// carregando entram com limites vazios e so puladas ao desenhar.
+		frustum.update(projection * view);
+		cullingBatch.clear();
+		for (int i = 0; i < numModels; i++)
+		{
+			modelMatrix[i] = glm::translate(glm::mat4(), modelPos[i]) * glm::scale(glm::mat4(), modelScale[i]);
+			cullingBatch.add(mesh[i]->isLoaded() ? mesh[i]->getBounds() : MeshBounds(), modelMatrix[i]);
+		}
+		for (size_t i = 0; i < barrelModel.size(); i++)
+			cullingBatch.add(barrelMesh->isLoaded() ? barrelMesh->getBounds() : MeshBounds(), barrelModel[i]);
+		gVisibleObjects = frustum.cull(cullingBatch, visible);
+		gTotalObjects = cullingBatch.size();
+
+		// Envia os objetos visveis  fila; a chave usa os ndices dos programas,
+		// texturas, materiais e malhas (barril = numModels)
+		renderQueue.clear();
+		drawItems.clear();
+		for (int i = 0; i < numModels; i++)
+		{
+			if (!visible[i] || !mesh[i]->isLoaded() || !isSceneTextureLoaded(texture[i]))
+				continue;
+
+			// LOD pelo tamanho projetado do objeto; malhas fora do arena usam o programa bsico
+			// Uma textura prpria recebe os nveis que a altura na tela pede
+			float screenSize = getScreenSize(cullingBatch, i, viewPos);
+			if (texture[i].texture)
+				textureStreamer.request(texture[i].texture.get(), screenSize * gWindowHeight);
+
+			SceneProgram objectProgram = (mesh[i]->getArena() != NULL) ? PROGRAM_BATCHED : PROGRAM_BASIC;
+			DrawItem item = { mesh[i].get(), &texture[i], objectProgram, modelMaterial[i],
+				mesh[i]->selectLOD(screenSize), modelMatrix[i], NULL };
+
+			// Camadas de um array e regies do atlas contam como uma textura s
+			float depth = glm::length(glm::vec3(modelMatrix[i][3]) - viewPos) / FAR_PLANE;
+			renderQueue.submit(RenderQueue::makeOpaqueKey(item.program, texture[i].binding, item.material, i, depth),
+				(GLuint)drawItems.size());
+			drawItems.push_back(item);
+		}
 
-		// Luz simples
-		shaderProgram.setUniform("view", view);
-		shaderProgram.setUniform("projection", projection);
-		shaderProgram.setUniform("viewPos", viewPos);
-		shaderProgram.setUniform("light.position", lightPos);
-		shaderProgram.setUniform("light.ambient", glm::vec3(0.2f, 0.2f, 0.2f));
-		shaderProgram.setUniform("light.diffuse", lightColor);
-		shaderProgram.setUniform("light.specular", glm::vec3(1.0f, 1.0f, 1.0f));
+		// Barris visveis separados por LOD, uma chamada de desenho instanciada por LOD
+		// na profundidade do barril mais prximo
+		float barrelDepth[MAX_MESH_LODS];
+		for (GLuint lod = 0; lod < MAX_MESH_LODS; lod++)
+		{
+			barrelInstances[lod].clear();
+			barrelDepth[lod] = 1.0f;
+		}
+		for (size_t i = 0; i < barrelModel.size(); i++)
+		{
+			size_t object = numModels + i;
+			if (!visible[object] || !barrelMesh->isLoaded() || !isSceneTextureLoaded(barrelTexture))
+				continue;
 
+			float screenSize = getScreenSize(cullingBatch, object, viewPos);
+			textureStreamer.request(barrelTexture.texture.get(), screenSize * gWindowHeight);
 
-		// Renderiza cena
-		for (int i = 0; i < numModels; i++)
+			GLuint lod = barrelMesh->selectLOD(screenSize);
+			barrelInstances[lod].push_back(barrelModel[i]);
+			barrelDepth[lod] = glm::min(barrelDepth[lod], glm::length(glm::vec3(barrelModel[i][3]) - viewPos) / FAR_PLANE);
+		}
+		for (GLuint lod = 0; lod < MAX_MESH_LODS; lod++)
 		{
-			model = glm::translate(glm::mat4(), modelPos[i]) * glm::scale(glm::mat4(), modelScale[i]);
-			shaderProgram.setUniform("model", model);
+			if (barrelInstances[lod].empty())
+				continue;
+
+			DrawItem item = { barrelMesh.get(), &barrelTexture, PROGRAM_INSTANCED, barrelMaterial, lod, glm::mat4(), &barrelInstances[lod] };
+			renderQueue.submit(RenderQueue::makeOpaqueKey(item.program, barrelTexture.binding, item.material, numModels, barrelDepth[lod]),
+				(GLuint)drawItems.size());
+			drawItems.push_back(item);
+		}
 
-			// Set material properties
-			shaderProgram.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-			shaderProgram.setUniformSampler("material.diffuseMap", 0);
-			shaderProgram.setUniform("material.specular", glm::vec3(0.5f, 0.5f, 0.5f));
-			shaderProgram.setUniform("material.shininess", 32.0f);
+		// Renderiza cena na ordem da fila; programa, textura e VAO repetidos so
+		// descartados pelo GLState, material e descompresso so comparados aqui.
+		// Desenhos seguidos do arena com a mesma textura e material so acumulados
+		// e enviados juntos quando o estado muda.
+		renderQueue.sort();
 
-			texture[i].bind(0);		// Seta a textura antes de desenhar
-			mesh[i].draw();			// Renderiza o objeto na malha
-			texture[i].unbind(0);
+		// Nveis de mipmap: envia os lidos, libera e pede outros pelo tamanho na tela
+		textureStreamer.update();
 
+		int boundMaterial = -1;
+		int batchBinding = -1;
+		const Mesh* programMesh[NUM_SCENE_PROGRAMS] = { NULL, NULL, NULL };
+		const SceneTexture* programTexture[NUM_SCENE_PROGRAMS] = { NULL, NULL, NULL };
+		for (size_t q = 0; q < renderQueue.size(); q++)
+		{
+			const DrawItem& item = drawItems[renderQueue[q].index];
+			ShaderProgram& program = *scenePrograms[item.program];
+
+			if (meshArena.getDrawCount() > 0 &&
+				(item.program != PROGRAM_BATCHED || item.texture->binding != batchBinding || item.material != boundMaterial))
+				meshArena.flush(DRAW_DATA_TEXTURE_UNIT);
+
+			// Deve ser chamado ANTES de configurar uniformes porque a configurao de uniformes  feita
+			//no programa de shader atualmente ativo.
+			program.use();
+
+			// Descompresso dos vrtices e regio da textura, por programa (no arena elas
+			// vo nos dados por desenho)
+			if (item.program != PROGRAM_BATCHED &&
+				(programMesh[item.program] != item.mesh || programTexture[item.program] != item.texture))
+			{
+				programMesh[item.program] = item.mesh;
+				programTexture[item.program] = item.texture;
+				setMeshUniforms(program, *programUniforms[item.program], *item.mesh, item.texture->uvTransform);
+			}
+
+			if (item.material != boundMaterial)
+			{
+				boundMaterial = item.material;
+				materialBuffer.bind(MATERIAL_BLOCK_BINDING, boundMaterial);
+			}
+
+			bindSceneTexture(*item.texture);		// Seta a textura antes de desenhar
+
+			// Renderiza o objeto na malha
+			if (item.program == PROGRAM_BATCHED)
+			{
+				batchBinding = item.texture->binding;
+				meshArena.addDraw(*item.mesh, item.lod, item.model, item.texture->layer, item.texture->uvTransform);
+			}
+			else if (item.instances != NULL)
+			{
+				program.setUniform(programUniforms[item.program]->diffuseLayer, item.texture->layer);
+
+				DynamicSlice instances;
+				GLsizei instanceCount = (GLsizei)item.instances->size();
+				if (dynamicBuffer.write(item.instances->data(), instanceCount * sizeof(glm::mat4), sizeof(glm::vec4), instances))
+				{
+					dynamicBuffer.flush();
+					item.mesh->setInstanceBuffer(instances.buffer, instances.offset, instanceCount);
+				}
+				else
+					item.mesh->setInstanceTransforms(item.instances->data(), instanceCount);
+				item.mesh->drawInstanced(item.lod);
+			}
+			else
+			{
+				program.setUniform(programUniforms[item.program]->model, item.model);
+				program.setUniform(programUniforms[item.program]->diffuseLayer, item.texture->layer);
+				item.mesh->draw(item.lod);
+			}
 		}
+		meshArena.flush(DRAW_DATA_TEXTURE_UNIT);
 
 		// Render the light bulb geometry
-		model = glm::translate(glm::mat4(), lightPos);
-		lightShader.use();
-		lightShader.setUniform("lightColor", lightColor);
-		lightShader.setUniform("model", model);
-		lightShader.setUniform("view", view);
-		lightShader.setUniform("projection", projection);
-		lightMesh.draw();
+		if (lightMesh->isLoaded())
+		{
+			model = glm::translate(glm::mat4(), lightPos);
+			lightShader.use();
+			lightShader.setUniform(lightColorUniform, lightColor);
+			lightShader.setUniform(lightModelUniform, model);
+			lightShader.setUniform(lightPosOffsetUniform, lightMesh->getDequantization().positionOffset);
+			lightShader.setUniform(lightPosScaleUniform, lightMesh->getDequantization().positionScale);
+			lightMesh->draw();
+		}
+
+		// Fence da regio do quadro no buffer dinmico
+		dynamicBuffer.endFrame();
 
 		// Swap front and back buffers
 		glfwSwapBuffers(gWindow);
@@ -287,9 +724,9 @@ void glfw_onKey(GLFWwindow* window, int key, int scancode, int action, int mode)
 	{
 		gWireframe = !gWireframe;
 		if (gWireframe)
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			GLState::polygonMode(GL_LINE);
 		else
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			GLState::polygonMode(GL_FILL);
 	}
 
 }
@@ -353,6 +790,78 @@ void update(double elapsedTime)
 		fpsCamera.move(MOVE_SPEED * (float)elapsedTime * -glm::vec3(0.0f, 1.0f, 0.0f));
 }
 
+//-----------------------------------------------------------------------------
+// Tamanho projetado da esfera envolvente de um objeto do batch de culling
+// (j no mundo): dimetro / altura da viewport
+//-----------------------------------------------------------------------------
+float getScreenSize(const CullingBatch& batch, size_t object, const glm::vec3& viewPos)
+{
+	glm::vec3 center(batch.sphereX[object], batch.sphereY[object], batch.sphereZ[object]);
+	float distance = glm::max(glm::length(center - viewPos), 1e-3f);
+	return batch.radius[object] / (distance * tanf(glm::radians(fpsCamera.getFOV()) * 0.5f));
+}
+
+//-----------------------------------------------------------------------------
+// Resolve os uniformes por objeto do shader dos objetos. No shader instanciado
+// a matriz model vem de um atributo por instncia.
+//-----------------------------------------------------------------------------
+SceneUniforms getSceneUniforms(ShaderProgram& shader, bool instanced)
+{
+	SceneUniforms uniforms;
+	if (!instanced)
+		uniforms.model = shader.getUniformHandle<glm::mat4>("model");
+	uniforms.posOffset = shader.getUniformHandle<glm::vec3>("posOffset");
+	uniforms.posScale = shader.getUniformHandle<glm::vec3>("posScale");
+	uniforms.uvOffset = shader.getUniformHandle<glm::vec2>("uvOffset");
+	uniforms.uvScale = shader.getUniformHandle<glm::vec2>("uvScale");
+	uniforms.octNormals = shader.getUniformHandle<GLint>("octNormals");
+	uniforms.diffuseLayer = shader.getUniformHandle<GLint>("diffuseLayer");
+	return uniforms;
+}
+
+//-----------------------------------------------------------------------------
+// Descompresso dos vrtices da malha; as uvs vo para a regio uvTransform
+// da textura (a inteira, ou a imagem no atlas)
+//-----------------------------------------------------------------------------
+void setMeshUniforms(ShaderProgram& shader, const SceneUniforms& uniforms, const Mesh& mesh, const glm::vec4& uvTransform)
+{
+	const VertexDequantization& dequantization = mesh.getDequantization();
+	glm::vec2 uvOffset = dequantization.texCoordOffset, uvScale = dequantization.texCoordScale;
+	TextureAtlas::applyTransform(uvTransform, uvOffset, uvScale);
+
+	shader.setUniform(uniforms.posOffset, dequantization.positionOffset);
+	shader.setUniform(uniforms.posScale, dequantization.positionScale);
+	shader.setUniform(uniforms.uvOffset, uvOffset);
+	shader.setUniform(uniforms.uvScale, uvScale);
+	shader.setUniform(uniforms.octNormals, dequantization.octahedralNormals);
+}
+
+//-----------------------------------------------------------------------------
+// Se a textura de um objeto j pode ser usada
+//-----------------------------------------------------------------------------
+bool isSceneTextureLoaded(const SceneTexture& texture)
+{
+	if (texture.array != NULL)
+		return texture.array->isLayerLoaded(texture.layer);
+	if (texture.atlas != NULL)
+		return texture.uvTransform.z > 0.0f;
+	return texture.texture->isLoaded();
+}
+
+//-----------------------------------------------------------------------------
+// Liga a textura de um objeto: a prpria ou o atlas na unidade 0, o texture
+// array na sua unidade
+//-----------------------------------------------------------------------------
+void bindSceneTexture(const SceneTexture& texture)
+{
+	if (texture.array != NULL)
+		texture.array->bind(DIFFUSE_ARRAY_TEXTURE_UNIT);
+	else if (texture.atlas != NULL)
+		texture.atlas->bind(0);
+	else
+		texture.texture->bind(0);
+}
+
 //-----------------------------------------------------------------------------
 // Calcula a mdia de frames por segundo, e tambm o tempo mdio que leva
 // para renderizar um quadro. Essas estatsticas so anexadas  barra de legenda da janela.
@@ -379,7 +888,11 @@ void showFPS(GLFWwindow* window)
 		outs << std::fixed
 			<< APP_TITLE << "    "
 			<< "FPS: " << fps << "    "
-			<< "Frame Time: " << msPerFrame << " (ms)";
+			<< "Frame Time: " << msPerFrame << " (ms)    "
+			<< "Visible: " << gVisibleObjects << " / " << gTotalObjects
+			<< " (" << gTotalObjects - gVisibleObjects << " culled)    "
+			<< "GL state: " << GLState::getStats().issued << " set, "
+			<< GLState::getStats().skipped << " skipped";
 		glfwSetWindowTitle(window, outs.str().c_str());
 
 		// Reset for next average.
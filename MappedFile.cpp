@@ -0,0 +1,164 @@
+#include "MappedFile.h"
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+MappedFile::MappedFile()
+	: mData(NULL),
+	mSize(0),
+	mMapped(false)
+#ifdef _WIN32
+	, mFile(NULL),
+	mMapping(NULL)
+#endif
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+//-----------------------------------------------------------------------------
+// Opens a file, mapping it if possible and reading it otherwise
+//-----------------------------------------------------------------------------
+bool MappedFile::open(const std::string& filename, bool useMapping)
+{
+	close();
+
+	if (useMapping && map(filename))
+		return true;
+
+	return read(filename);
+}
+
+//-----------------------------------------------------------------------------
+// Releases the mapping or the buffer
+//-----------------------------------------------------------------------------
+void MappedFile::close()
+{
+	if (mMapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mData);
+		CloseHandle((HANDLE)mMapping);
+		CloseHandle((HANDLE)mFile);
+		mMapping = NULL;
+		mFile = NULL;
+#else
+		munmap((void*)mData, mSize);
+#endif
+	}
+
+	std::vector<char>().swap(mBuffer);
+	mData = NULL;
+	mSize = 0;
+	mMapped = false;
+}
+
+//-----------------------------------------------------------------------------
+// Maps the whole file read-only.  Empty files can't be mapped and fall back.
+//-----------------------------------------------------------------------------
+bool MappedFile::map(const std::string& filename)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = (const char*)view;
+	mSize = (size_t)size.QuadPart;
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);	// the mapping keeps its own reference to the file
+	if (view == MAP_FAILED)
+		return false;
+
+	madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	mData = (const char*)view;
+	mSize = (size_t)st.st_size;
+#endif
+
+	mMapped = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Reads the whole file into mBuffer
+//-----------------------------------------------------------------------------
+bool MappedFile::read(const std::string& filename)
+{
+	std::ifstream fin(filename, std::ios::in | std::ios::binary);
+	if (!fin)
+		return false;
+
+	fin.seekg(0, std::ios::end);
+	std::streamoff size = fin.tellg();
+	fin.seekg(0, std::ios::beg);
+
+	mBuffer.resize((size_t)size);
+	if (size > 0)
+		fin.read(&mBuffer[0], size);
+
+	if (fin.fail())
+	{
+		std::vector<char>().swap(mBuffer);
+		return false;
+	}
+
+	mData = mBuffer.data();
+	mSize = mBuffer.size();
+	return true;
+}
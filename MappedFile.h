@@ -0,0 +1,45 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <vector>
+#include <string>
+
+
+//--------------------------------------------------------------
+// Read-only view of a whole file.
+//
+// The file is memory mapped when the platform allows it so callers
+// parse straight out of the page cache; otherwise (or on request)
+// it is read in one go into a private buffer.
+//--------------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::string& filename, bool useMapping = true);
+	void close();
+
+	const char* data() const { return mData; }
+	size_t size() const { return mSize; }
+	bool isMapped() const { return mMapped; }
+
+private:
+	MappedFile(const MappedFile& rhs);
+	MappedFile& operator = (const MappedFile& rhs);
+
+	bool map(const std::string& filename);
+	bool read(const std::string& filename);
+
+	const char* mData;
+	size_t mSize;
+	bool mMapped;
+	std::vector<char> mBuffer;
+
+#ifdef _WIN32
+	void* mFile;
+	void* mMapping;
+#endif
+};
+#endif //MAPPEDFILE_H
@@ -1,41 +1,55 @@
 #include "Mesh.h"
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexPacker.h"
+#include "GLState.h"
+#include "MeshArena.h"
+#include <algorithm>
 #include <iostream>
-#include <sstream>
-#include <fstream>
-
-
-// ------------------------------------------------ -----------------------------
-// Dividir
-//
-// Params: s - string para dividir
-//		   t - string para dividir (ou seja, delimitador)
-//
-// Resultado: Divide a string de acordo com alguma substring e a retorna como um vetor.
-// ------------------------------------------------ -----------------------------
-std::vector<std::string> split(std::string s, std::string t)
-{
-	std::vector<std::string> res;
-	while (1)
-	{
-		int pos = s.find(t);
-		if (pos == -1)
-		{
-			res.push_back(s);
-			break;
-		}
-		res.push_back(s.substr(0, pos));
-		s = s.substr(pos + 1, s.size() - pos - 1);
-	}
-	return res;
-}
 
 
+// Erro mximo de simplificao de um LOD, relativo ao tamanho do modelo
+const float LOD_MAX_ERROR = 0.05f;
+
+// Tamanho na tela (dimetro / altura da viewport) abaixo do qual se usa o LOD 1;
+// cada LOD seguinte vale para metade do tamanho
+const float LOD_SCREEN_SIZE = 0.5f;
+
 //-----------------------------------------------------------------------------
 // Construtor
 //-----------------------------------------------------------------------------
 Mesh::Mesh()
-	:mLoaded(false)
+	:mLoaded(false),
+	mFailed(false),
+	mFormat(VERTEX_FORMAT_FLOAT),
+	mVertexCount(0),
+	mIndexCount(0),
+	mIndexType(GL_UNSIGNED_INT),
+	mLODCount(1),
+	mVBO(0),
+	mIBO(0),
+	mVAO(0),
+	mArena(NULL),
+	mBaseVertex(0),
+	mStagingCache(NULL),
+	mInstanceVBO(0),
+	mInstanceCount(0),
+	mInstanceCapacity(0),
+	mInstanceSource(0),
+	mInstanceOffset(0)
 {
+	mDequantization.positionScale = glm::vec3(1.0f);
+	mDequantization.texCoordScale = glm::vec2(1.0f);
+	mDequantization.octahedralNormals = 0;
+	mBounds.sphereRadius = 0.0f;
+	mStaging.vertexCount = mStaging.indexCount = 0;
+	mStaging.indexSize = 0;
+
+	for (GLuint i = 0; i < MAX_MESH_LODS; i++)
+		mLODs[i].firstIndex = mLODs[i].indexCount = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -43,25 +57,83 @@ Mesh::Mesh()
 //-----------------------------------------------------------------------------
 Mesh::~Mesh()
 {
-	glDeleteVertexArrays(1, &mVAO);
+	GLState::deleteVertexArray(mVAO);
 	glDeleteBuffers(1, &mVBO);
+	glDeleteBuffers(1, &mIBO);
+	glDeleteBuffers(1, &mInstanceVBO);
+	delete mStagingCache;
+}
+
+//-----------------------------------------------------------------------------
+// Nmero de nveis de detalhe (1 a MAX_MESH_LODS), cada um com metade dos
+// tringulos do anterior. Deve ser chamado antes de loadOBJ.
+//-----------------------------------------------------------------------------
+void Mesh::setLODCount(GLuint count)
+{
+	mLODCount = glm::clamp(count, 1u, MAX_MESH_LODS);
+}
+
+//-----------------------------------------------------------------------------
+// Guarda a malha no arena compartilhado, no formato de vrtice dele.
+// Deve ser chamado antes de loadOBJ.
+//-----------------------------------------------------------------------------
+void Mesh::setArena(MeshArena* arena)
+{
+	mArena = arena;
+	if (mArena != NULL)
+		mFormat = mArena->getVertexFormat();
 }
 
 //-----------------------------------------------------------------------------
 // Carrega um modelo OBJ
+// optimize reordena tringulos e vrtices para o cache de vrtices da GPU
 //-----------------------------------------------------------------------------
-bool Mesh::loadOBJ(const std::string& filename)
+bool Mesh::loadOBJ(const std::string& filename, bool optimize)
 {
-	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> tempVertices;
-	std::vector<glm::vec2> tempUVs;
-	std::vector<glm::vec3> tempNormals;
+	if (!prepareOBJ(filename, optimize))
+	{
+		mFailed = true;
+		return false;
+	}
+	return upload();
+}
 
+//-----------------------------------------------------------------------------
+// Parte da carga que no usa OpenGL: l o cache binrio ou faz o parse do OBJ
+// e deixa os vrtices e ndices prontos para upload(). Pode rodar numa thread
+// de trabalho; at upload() a malha no deve ser usada por outra thread.
+//-----------------------------------------------------------------------------
+bool Mesh::prepareOBJ(const std::string& filename, bool optimize)
+{
+	GLuint cacheFlags = optimize ? MESH_CACHE_OPTIMIZED : 0;
 
 	if (filename.find(".obj") != std::string::npos)
 	{
-		std::ifstream fin(filename, std::ios::in);
-		if (!fin)
+		// Usa o cache binrio se ele for mais novo que o OBJ; os vrtices vo direto do arquivo mapeado para a GPU
+		MeshCache* cache = new MeshCache();
+		if (cache->open(filename, mFormat, cacheFlags, mLODCount))
+		{
+			std::cout << "Loading mesh cache " << MeshCache::getCachePath(filename, mFormat, cacheFlags, mLODCount) << " ..." << std::endl;
+
+			const MeshCacheHeader& header = cache->getHeader();
+			mDequantization = header.dequantization;
+			mBounds = header.bounds;
+			for (GLuint i = 0; i < mLODCount; i++)
+				mLODs[i] = header.lods[i];
+
+			mStaging.layout = header.layout;
+			mStaging.vertexCount = header.vertexCount;
+			mStaging.indexCount = header.indexCount;
+			mStaging.indexSize = header.indexSize;
+			delete mStagingCache;
+			mStagingCache = cache;
+			return true;
+		}
+		delete cache;
+
+		// Mapeia o arquivo e faz o parse direto sobre os bytes mapeados
+		MappedFile file;
+		if (!file.open(filename))
 		{
 			std::cerr << "Cannot open " << filename << std::endl;
 			return false;
@@ -69,159 +141,336 @@ bool Mesh::loadOBJ(const std::string& filename)
 
 		std::cout << "Loading OBJ file " << filename << " ..." << std::endl;
 
-		std::string lineBuffer;
-		while (std::getline(fin, lineBuffer))
+		ObjData data;
+		ObjLoader::parse(file.data(), file.data() + file.size(), data);
+		mBounds = data.bounds;
+
+		// Um vrtice para cada tripla (v, vt, vn) distinta e um ndice por canto de tringulo
+		ObjLoader::buildIndexedVertices(data, mVertices, mIndices);
+
+		// LODs simplificados, todos no mesmo buffer de ndices
+		buildLODs();
+
+		if (optimize)
+			optimizeIndices();
+
+		// ndices de 16 bits quando todos os vrtices cabem
+		mStaging.indexCount = (GLsizei)mIndices.size();
+		if (mVertices.size() <= 0x10000)
+		{
+			std::vector<GLushort> shortIndices(mIndices.begin(), mIndices.end());
+			mStaging.indexSize = sizeof(GLushort);
+			mStaging.indexData.assign((const unsigned char*)shortIndices.data(),
+				(const unsigned char*)(shortIndices.data() + shortIndices.size()));
+		}
+		else
 		{
-			std::stringstream ss(lineBuffer);
-			std::string cmd;
-			ss >> cmd;
-
-			if (cmd == "v")
-			{
-				glm::vec3 vertex;
-				int dim = 0;
-				while (dim < 3 && ss >> vertex[dim])
-					dim++;
-
-				tempVertices.push_back(vertex);
-			}
-			else if (cmd == "vt")
-			{
-				glm::vec2 uv;
-				int dim = 0;
-				while (dim < 2 && ss >> uv[dim])
-					dim++;
-
-				tempUVs.push_back(uv);
-			}
-			else if (cmd == "vn")
-			{
-				glm::vec3 normal;
-				int dim = 0;
-				while (dim < 3 && ss >> normal[dim])
-					dim++;
-				normal = glm::normalize(normal);
-				tempNormals.push_back(normal);
-			}
-			else if (cmd == "f")
-			{
-				std::string faceData;
-				int vertexIndex, uvIndex, normalIndex;
-
-				while (ss >> faceData)
-				{
-					std::vector<std::string> data = split(faceData, "/");
-
-					if (data[0].size() > 0)
-					{
-						sscanf_s(data[0].c_str(), "%d", &vertexIndex);
-						vertexIndices.push_back(vertexIndex);
-					}
-
-					if (data.size() >= 1)
-					{
-						//  o formato da face v // vn? Se data [1] for uma string vazia,
-						// este vrtice no tem coordenada de textura
-						if (data[1].size() > 0)
-						{
-							sscanf_s(data[1].c_str(), "%d", &uvIndex);
-							uvIndices.push_back(uvIndex);
-						}
-					}
-
-					if (data.size() >= 2)
-					{
-						// Este vrtice tem um normal?
-						if (data[2].size() > 0)
-						{
-							sscanf_s(data[2].c_str(), "%d", &normalIndex);
-							normalIndices.push_back(normalIndex);
-						}
-					}
-				}
-			}
+			mStaging.indexSize = sizeof(GLuint);
+			mStaging.indexData.assign((const unsigned char*)mIndices.data(),
+				(const unsigned char*)(mIndices.data() + mIndices.size()));
 		}
 
-		// fecha o arquivo
-		fin.close();
+		// Converte os vrtices para o formato do vertex buffer
+		VertexPacker::pack(mFormat, mVertices, mStaging.vertexData, mDequantization);
+		mStaging.layout = VertexPacker::getLayout(mFormat);
+		mStaging.vertexCount = (GLsizei)mVertices.size();
+
+		MeshCacheHeader header = MeshCacheHeader();
+		header.vertexFormat = mFormat;
+		header.layout = mStaging.layout;
+		header.dequantization = mDequantization;
+		header.vertexCount = (GLuint)mVertices.size();
+		header.indexCount = (GLuint)mIndices.size();
+		header.indexSize = mStaging.indexSize;
+		header.flags = cacheFlags;
+		header.lodCount = mLODCount;
+		for (GLuint i = 0; i < mLODCount; i++)
+			header.lods[i] = mLODs[i];
+		header.bounds = mBounds;
+
+		MeshCache::write(filename, file, header, mStaging.vertexData.data(), mStaging.indexData.data());
+		file.close();
+
+		return true;
+	}
 
+	//Se falhar...
+	return false;
+}
 
-		// Para cada vrtice de cada tringulo
-		for (unsigned int i = 0; i < vertexIndices.size(); i++)
-		{
-			Vertex meshVertex;
+//-----------------------------------------------------------------------------
+// Cria os buffers com o que prepareOBJ deixou pronto e libera a cpia na
+// memria. Precisa do contexto OpenGL, ou seja, roda na thread de renderizao.
+//-----------------------------------------------------------------------------
+bool Mesh::upload()
+{
+	const void* vertexData = mStaging.vertexData.data();
+	const void* indexData = mStaging.indexData.data();
+	if (mStagingCache != NULL)
+	{
+		vertexData = mStagingCache->getVertexData();
+		indexData = mStagingCache->getIndexData();
+	}
+	else if (mStaging.vertexData.empty())
+	{
+		mFailed = true;
+		return false;
+	}
 
-			// Obtm os atributos usando os ndices
+	initBuffers(vertexData, mStaging.vertexCount, mStaging.layout, indexData, mStaging.indexCount, mStaging.indexSize);
 
-			if (tempVertices.size() > 0)
-			{
-				glm::vec3 vertex = tempVertices[vertexIndices[i] - 1];
-				meshVertex.position = vertex;
-			}
+	delete mStagingCache;
+	mStagingCache = NULL;
+	std::vector<unsigned char>().swap(mStaging.vertexData);
+	std::vector<unsigned char>().swap(mStaging.indexData);
 
-			if (tempNormals.size() > 0)
-			{
-				glm::vec3 normal = tempNormals[normalIndices[i] - 1];
-				meshVertex.normal = normal;
-			}
+	return (mLoaded = true);
+}
 
-			if (tempUVs.size() > 0)
-			{
-				glm::vec2 uv = tempUVs[uvIndices[i] - 1];
-				meshVertex.texCoords = uv;
-			}
+//-----------------------------------------------------------------------------
+// Gera os LODs simplificando cada nvel a partir do anterior e concatena
+// os ndices de todos em mIndices. Um nvel que no consegue mais reduzir
+// (costuras, cantos travados) repete o anterior.
+//-----------------------------------------------------------------------------
+void Mesh::buildLODs()
+{
+	mLODs[0].firstIndex = 0;
+	mLODs[0].indexCount = (GLuint)mIndices.size();
+
+	std::vector<GLuint> lod(mIndices);
+	for (GLuint i = 1; i < mLODCount; i++)
+	{
+		size_t target = (mLODs[0].indexCount >> i) / 3 * 3;
+		std::vector<GLuint> simplified = MeshSimplifier::simplify(mVertices, lod, target, LOD_MAX_ERROR);
 
-			mVertices.push_back(meshVertex);
+		if (simplified.size() < lod.size())
+		{
+			lod.swap(simplified);
+			mLODs[i].firstIndex = (GLuint)mIndices.size();
+			mLODs[i].indexCount = (GLuint)lod.size();
+			mIndices.insert(mIndices.end(), lod.begin(), lod.end());
 		}
+		else
+			mLODs[i] = mLODs[i - 1];
+
+		std::cout << "  LOD " << i << ": " << mLODs[i].indexCount / 3 << " of " << mLODs[0].indexCount / 3 << " triangles" << std::endl;
+	}
+}
 
-		// Cria e inicializa os buffers
-		initBuffers();
+//-----------------------------------------------------------------------------
+// Otimiza a ordem dos tringulos de cada LOD para o cache ps-transformao e
+// o overdraw, depois a ordem dos vrtices para o fetch. Mostra ACMR/ATVR do
+// LOD 0 antes e depois.
+//-----------------------------------------------------------------------------
+void Mesh::optimizeIndices()
+{
+	VertexCacheStats before = VertexCacheStats(), after = before;
 
-		return (mLoaded = true);
+	for (GLuint i = 0; i < mLODCount; i++)
+	{
+		// LOD repetido j foi otimizado
+		if (i > 0 && mLODs[i].firstIndex == mLODs[i - 1].firstIndex)
+			continue;
+
+		std::vector<GLuint>::iterator first = mIndices.begin() + mLODs[i].firstIndex;
+		std::vector<GLuint> lod(first, first + mLODs[i].indexCount);
+		std::vector<GLuint> indices(lod);
+		MeshOptimizer::optimizeVertexCache(indices, mVertices.size());
+		MeshOptimizer::optimizeOverdraw(indices, mVertices);
+
+		VertexCacheStats lodBefore = MeshOptimizer::analyzeVertexCache(lod, mVertices.size());
+		VertexCacheStats lodAfter = MeshOptimizer::analyzeVertexCache(indices, mVertices.size());
+
+		// Malhas que j vm bem ordenadas ficam como esto
+		if (lodAfter.acmr < lodBefore.acmr)
+			std::copy(indices.begin(), indices.end(), first);
+		else
+			lodAfter = lodBefore;
+
+		if (i == 0)
+		{
+			before = lodBefore;
+			after = lodAfter;
+		}
 	}
 
-	//Se falhar...
-	return false;
+	// A ordem dos vrtices segue o LOD 0, que vem primeiro no buffer
+	MeshOptimizer::optimizeVertexFetch(mVertices, mIndices);
+
+	std::cout << "  vertex cache ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
 }
 
 //-----------------------------------------------------------------------------
-// Cria e inicializa o buffer de vrtice e o objeto array de vrtices
-// Deve ter objetos std :: vector vlidos e no vazios de objetos Vertex.
+// Cria e inicializa o buffer de vrtice, o buffer de ndices e o objeto array de vrtices
+// vertexData deve apontar para vertexCount vrtices no formato descrito por layout
+// e indexData para indexCount ndices de indexSize bytes (2 ou 4).
 //-----------------------------------------------------------------------------
-void Mesh::initBuffers()
+void Mesh::initBuffers(const void* vertexData, GLsizei vertexCount, const VertexLayout& layout,
+	const void* indexData, GLsizei indexCount, GLuint indexSize)
 {
+	mVertexCount = vertexCount;
+	mIndexCount = indexCount;
+	mIndexType = (indexSize == sizeof(GLushort)) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	// No arena os ndices so de 32 bits e os LODs passam a apontar para o buffer compartilhado;
+	// se o arena no aceitar a malha, ela usa buffers prprios
+	GLuint firstIndex = 0;
+	if (mArena != NULL && indexCount > 0 &&
+		mArena->allocate(vertexData, vertexCount, indexData, indexCount, indexSize, mBaseVertex, firstIndex))
+	{
+		mIndexType = GL_UNSIGNED_INT;
+		for (GLuint i = 0; i < mLODCount; i++)
+			mLODs[i].firstIndex += firstIndex;
+		return;
+	}
+	mArena = NULL;
+
 	glGenVertexArrays(1, &mVAO);
 	glGenBuffers(1, &mVBO);
 
-	glBindVertexArray(mVAO);
+	GLState::bindVertexArray(mVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-	glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), &mVertices[0], GL_STATIC_DRAW);
-
-	// Posies dos vrtices
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.stride, vertexData, GL_STATIC_DRAW);
 
-	//Atributos da normal
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
+	// O buffer de ndices fica associado ao VAO
+	if (indexCount > 0)
+	{
+		glGenBuffers(1, &mIBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indexData, GL_STATIC_DRAW);
+	}
 
-	// Coords da textura do vrtice
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(6 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
+	// Posies, normais e coords de textura dos vrtices, conforme o layout
+	for (GLuint i = 0; i < layout.attributeCount; i++)
+	{
+		const VertexAttribute& attribute = layout.attributes[i];
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+			(GLboolean)attribute.normalized, layout.stride, (GLvoid*)(size_t)attribute.offset);
+		glEnableVertexAttribArray(attribute.location);
+	}
 
 	// desassocie para garantir que outro cdigo no o altere em outro lugar
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 }
 
 //-----------------------------------------------------------------------------
-// Renderize a malha
+// Escolhe o LOD para o tamanho projetado da malha na tela
 //-----------------------------------------------------------------------------
-void Mesh::draw()
+GLuint Mesh::selectLOD(float screenSize) const
+{
+	GLuint lod = 0;
+	float threshold = LOD_SCREEN_SIZE;
+	while (lod + 1 < mLODCount && screenSize < threshold)
+	{
+		lod++;
+		threshold *= 0.5f;
+	}
+	return lod;
+}
+
+//-----------------------------------------------------------------------------
+// Renderize a malha no nvel de detalhe lod
+//-----------------------------------------------------------------------------
+void Mesh::draw(GLuint lod)
 {
 	if (!mLoaded) return;
 
-	glBindVertexArray(mVAO);
-	glDrawArrays(GL_TRIANGLES, 0, mVertices.size());
-	glBindVertexArray(0);
+	// O VAO fica ligado depois do desenho; a prxima malha s troca se for outra
+	if (mArena != NULL)
+	{
+		const MeshLOD& range = getLOD(lod);
+		GLState::bindVertexArray(mArena->getVertexArray());
+		glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+			(GLvoid*)(size_t)(range.firstIndex * sizeof(GLuint)), mBaseVertex);
+		return;
+	}
+
+	GLState::bindVertexArray(mVAO);
+	if (mIndexCount > 0)
+	{
+		const MeshLOD& range = mLODs[glm::min(lod, mLODCount - 1)];
+		GLuint indexSize = (mIndexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+		glDrawElements(GL_TRIANGLES, range.indexCount, mIndexType, (GLvoid*)(size_t)(range.firstIndex * indexSize));
+	}
+	else
+		glDrawArrays(GL_TRIANGLES, 0, mVertexCount);
 }
 
+//-----------------------------------------------------------------------------
+// Envia as matrizes model das instncias. O buffer de instncias  criado no
+// primeiro uso e ligado ao VAO nas locations 3 a 6 (uma coluna da mat4 por
+// location, divisor 1); s  realocado quando no cabe mais.
+//-----------------------------------------------------------------------------
+void Mesh::setInstanceTransforms(const glm::mat4* transforms, GLsizei count)
+{
+	if (!mLoaded || mArena != NULL) return;
+
+	if (mInstanceVBO == 0)
+		glGenBuffers(1, &mInstanceVBO);
+	setInstanceBuffer(mInstanceVBO, 0, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+	if (count > mInstanceCapacity)
+	{
+		mInstanceCapacity = count;
+		glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), transforms, GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		// Descarta o contedo anterior para no esperar pelos draws que ainda o usam
+		glBufferData(GL_ARRAY_BUFFER, mInstanceCapacity * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mInstanceCount = count;
+}
+
+//-----------------------------------------------------------------------------
+// Liga os atributos de instncia (locations 3 a 6) a matrizes j escritas num
+// buffer a partir de offset. S respecifica os ponteiros quando a origem muda.
+//-----------------------------------------------------------------------------
+void Mesh::setInstanceBuffer(GLuint buffer, GLintptr offset, GLsizei count)
+{
+	if (!mLoaded || mArena != NULL) return;
+
+	if (buffer != mInstanceSource || offset != mInstanceOffset)
+	{
+		GLState::bindVertexArray(mVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (GLuint column = 0; column < 4; column++)
+		{
+			GLuint location = INSTANCE_ATTRIBUTE_LOCATION + column;
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(offset + column * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(location);
+			glVertexAttribDivisor(location, 1);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GLState::bindVertexArray(0);
+
+		mInstanceSource = buffer;
+		mInstanceOffset = offset;
+	}
+
+	mInstanceCount = count;
+}
+
+//-----------------------------------------------------------------------------
+// Renderiza todas as instncias enviadas por setInstanceTransforms com uma
+// nica chamada de desenho
+//-----------------------------------------------------------------------------
+void Mesh::drawInstanced(GLuint lod)
+{
+	if (!mLoaded || mInstanceCount == 0) return;
+
+	GLState::bindVertexArray(mVAO);
+	if (mIndexCount > 0)
+	{
+		const MeshLOD& range = mLODs[glm::min(lod, mLODCount - 1)];
+		GLuint indexSize = (mIndexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+		glDrawElementsInstanced(GL_TRIANGLES, range.indexCount, mIndexType, (GLvoid*)(size_t)(range.firstIndex * indexSize), mInstanceCount);
+	}
+	else
+		glDrawArraysInstanced(GL_TRIANGLES, 0, mVertexCount, mInstanceCount);
+}
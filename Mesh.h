@@ -15,6 +15,79 @@ struct Vertex
 	glm::vec2 texCoords;
 };
 
+// How vertices are stored in the vertex buffer
+enum VertexFormat
+{
+	VERTEX_FORMAT_FLOAT,	// 32 bytes: float position, normal and uv (the Vertex struct)
+	VERTEX_FORMAT_HALF,		// 16 bytes: half position, 10:10:10:2 normal, unorm16 uv
+	VERTEX_FORMAT_SNORM16	// 16 bytes: snorm16 position, octahedral snorm16 normal, unorm16 uv
+};
+
+// One vertex attribute as glVertexAttribPointer sees it
+struct VertexAttribute
+{
+	GLuint location;
+	GLuint components;
+	GLuint type;		// GL_FLOAT, GL_SHORT, ...
+	GLuint normalized;
+	GLuint offset;
+};
+
+const GLuint MAX_VERTEX_ATTRIBUTES = 4;
+
+struct VertexLayout
+{
+	GLuint stride;
+	GLuint attributeCount;
+	VertexAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+};
+
+// Turns quantized attributes back into object space in the vertex shader:
+// position = positionOffset + positionScale * stored, same for texCoords
+struct VertexDequantization
+{
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+	glm::vec2 texCoordOffset;
+	glm::vec2 texCoordScale;
+	GLint octahedralNormals;
+};
+
+// Object space bounding volumes of a mesh
+struct MeshBounds
+{
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+};
+
+// One level of detail: a range of the mesh's index buffer
+struct MeshLOD
+{
+	GLuint firstIndex;
+	GLuint indexCount;
+};
+
+const GLuint MAX_MESH_LODS = 4;
+
+// Per-instance model matrix of drawInstanced, one column per location (3..6)
+const GLuint INSTANCE_ATTRIBUTE_LOCATION = 3;
+
+class MeshArena;
+class MeshCache;
+
+// Vertices and indices ready for the GPU, between Mesh::prepareOBJ and Mesh::upload
+struct MeshStaging
+{
+	VertexLayout layout;
+	GLsizei vertexCount;
+	GLsizei indexCount;
+	GLuint indexSize;
+	std::vector<unsigned char> vertexData;	// empty when they come from a mapped cache
+	std::vector<unsigned char> indexData;
+};
+
 class Mesh
 {
 public:
@@ -22,15 +95,74 @@ public:
 	Mesh();
 	~Mesh();
 
-	bool loadOBJ(const std::string& filename);
-	void draw();
+	// Must be called before loadOBJ
+	void setVertexFormat(VertexFormat format) { mFormat = format; }
+	void setLODCount(GLuint count);
+
+	// Must be called before loadOBJ: store the mesh in a shared arena instead of
+	// its own buffers (same vertex format as the arena; no drawInstanced)
+	void setArena(MeshArena* arena);
+
+	bool loadOBJ(const std::string& filename, bool optimize = false);
+
+	// loadOBJ in two steps: prepareOBJ has no GL calls and may run on any
+	// thread, upload creates the buffers on the GL thread
+	bool prepareOBJ(const std::string& filename, bool optimize = false);
+	bool upload();
+	bool isLoaded() const { return mLoaded; }
+
+	// upload() found nothing prepared: the file is missing or not an OBJ
+	bool hasFailed() const { return mFailed; }
+
+	void draw(GLuint lod = 0);
+
+	// Instancing: upload the model matrices, then draw every instance in one call
+	void setInstanceTransforms(const glm::mat4* transforms, GLsizei count);
+
+	// Or point the instances at count matrices already in a buffer (e.g. a DynamicBuffer slice)
+	void setInstanceBuffer(GLuint buffer, GLintptr offset, GLsizei count);
+	void drawInstanced(GLuint lod = 0);
+
+	// Level of detail for a projected size (bounding diameter / viewport height)
+	GLuint selectLOD(float screenSize) const;
+	GLuint getLODCount() const { return mLODCount; }
+
+	const VertexDequantization& getDequantization() const { return mDequantization; }
+	const MeshBounds& getBounds() const { return mBounds; }
+
+	// Index range of a LOD and the vertex its indices are relative to
+	const MeshLOD& getLOD(GLuint lod) const { return mLODs[glm::min(lod, mLODCount - 1)]; }
+	GLint getBaseVertex() const { return mBaseVertex; }
+	MeshArena* getArena() const { return mArena; }
 
 private:
 
-	void initBuffers();
+	void buildLODs();
+	void optimizeIndices();
+	void initBuffers(const void* vertexData, GLsizei vertexCount, const VertexLayout& layout,
+		const void* indexData, GLsizei indexCount, GLuint indexSize);
 
 	bool mLoaded;
+	bool mFailed;
+	VertexFormat mFormat;
+	VertexDequantization mDequantization;
+	MeshBounds mBounds;
 	std::vector<Vertex> mVertices;
-	GLuint mVBO, mVAO;
+	std::vector<GLuint> mIndices;
+	GLsizei mVertexCount;
+	GLsizei mIndexCount;
+	GLenum mIndexType;
+	GLuint mLODCount;
+	MeshLOD mLODs[MAX_MESH_LODS];
+	GLuint mVBO, mIBO, mVAO;
+	MeshArena* mArena;
+	GLint mBaseVertex;
+	MeshStaging mStaging;
+	MeshCache* mStagingCache;
+	GLuint mInstanceVBO;
+	GLsizei mInstanceCount;
+	GLsizei mInstanceCapacity;
+	GLuint mInstanceSource;		// buffer the instance attributes read, at mInstanceOffset
+	GLintptr mInstanceOffset;
 };
 #endif //MESH_H
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "MeshArena.h"
+#include "VertexPacker.h"
+#include "GLState.h"
+#include "DynamicBuffer.h"
+#include "TextureAtlas.h"
+#include <iostream>
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+MeshArena::MeshArena()
+	: mFormat(VERTEX_FORMAT_FLOAT),
+	mIndirect(false),
+	mVAO(0),
+	mVBO(0),
+	mIBO(0),
+	mVertexCount(0),
+	mVertexCapacity(0),
+	mIndexCount(0),
+	mIndexCapacity(0),
+	mIndirectBuffer(0),
+	mDrawIdBuffer(0),
+	mDrawCapacity(0),
+	mDrawDataBuffer(0),
+	mDrawDataTexture(0),
+	mDynamic(NULL),
+	mTextureBufferRange(false),
+	mTextureBufferAlignment(1)
+{
+	mLayout = VertexLayout();
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+MeshArena::~MeshArena()
+{
+	GLState::deleteVertexArray(mVAO);
+	GLState::deleteTexture(mDrawDataTexture);
+	glDeleteBuffers(1, &mVBO);
+	glDeleteBuffers(1, &mIBO);
+	glDeleteBuffers(1, &mIndirectBuffer);
+	glDeleteBuffers(1, &mDrawIdBuffer);
+	glDeleteBuffers(1, &mDrawDataBuffer);
+}
+
+//-----------------------------------------------------------------------------
+// Creates the shared buffers with room for the given vertex and index counts
+//-----------------------------------------------------------------------------
+bool MeshArena::create(VertexFormat format, GLsizei vertexCapacity, GLsizei indexCapacity)
+{
+	if (mVAO != 0)
+	{
+		std::cerr << "Mesh arena already created!" << std::endl;
+		return false;
+	}
+
+	mFormat = format;
+	mLayout = VertexPacker::getLayout(format);
+	mVertexCapacity = glm::max(vertexCapacity, 1);
+	mIndexCapacity = glm::max(indexCapacity, 1);
+
+	// baseInstance only reaches the shader with ARB_base_instance (core in 4.2)
+	mIndirect = (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_draw_indirect)) &&
+		(GLEW_VERSION_4_2 || GLEW_ARB_base_instance);
+
+	mTextureBufferRange = GLEW_VERSION_4_3 || GLEW_ARB_texture_buffer_range;
+	if (mTextureBufferRange)
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		mTextureBufferAlignment = (alignment > 0) ? alignment : 256;
+	}
+
+	glGenVertexArrays(1, &mVAO);
+	glGenBuffers(1, &mVBO);
+	glGenBuffers(1, &mIBO);
+	glGenBuffers(1, &mDrawDataBuffer);
+	glGenTextures(1, &mDrawDataTexture);
+	if (mIndirect)
+	{
+		glGenBuffers(1, &mIndirectBuffer);
+		glGenBuffers(1, &mDrawIdBuffer);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)mVertexCapacity * mLayout.stride, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLState::bindVertexArray(mVAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)mIndexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+	GLState::bindVertexArray(0);
+
+	bindBuffers();
+
+	std::cout << "Mesh arena: " << (mIndirect ? "glMultiDrawElementsIndirect" : "glDrawElementsBaseVertex fallback") << std::endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Points the VAO at the current vertex and index buffers (again after they
+// grow) and sets up the draw ID attribute
+//-----------------------------------------------------------------------------
+void MeshArena::bindBuffers()
+{
+	GLState::bindVertexArray(mVAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	for (GLuint i = 0; i < mLayout.attributeCount; i++)
+	{
+		const VertexAttribute& attribute = mLayout.attributes[i];
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+			(GLboolean)attribute.normalized, mLayout.stride, (GLvoid*)(size_t)attribute.offset);
+		glEnableVertexAttribArray(attribute.location);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO);
+
+	// Indirect draws read the draw ID from the instance attribute; the
+	// fallback leaves the array disabled and sets the attribute's constant value
+	if (mIndirect)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+		glVertexAttribIPointer(DRAW_ID_ATTRIBUTE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+		glVertexAttribDivisor(DRAW_ID_ATTRIBUTE_LOCATION, 1);
+		glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE_LOCATION);
+	}
+	else
+		glDisableVertexAttribArray(DRAW_ID_ATTRIBUTE_LOCATION);
+
+	GLState::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Replaces buffer by a bigger one holding the same first usedBytes
+//-----------------------------------------------------------------------------
+void MeshArena::growBuffer(GLuint& buffer, GLsizeiptr usedBytes, GLsizeiptr newBytes)
+{
+	GLuint grown = 0;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+
+	if (usedBytes > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &buffer);
+	buffer = grown;
+}
+
+//-----------------------------------------------------------------------------
+// Appends a mesh's vertices and indices.  Indices stay relative to the mesh;
+// baseVertex and firstIndex say where it landed.
+//-----------------------------------------------------------------------------
+bool MeshArena::allocate(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount,
+	GLuint indexSize, GLint& baseVertex, GLuint& firstIndex)
+{
+	if (mVAO == 0)
+	{
+		std::cerr << "Mesh arena not created!" << std::endl;
+		return false;
+	}
+
+	// Grows by doubling, so loading many meshes copies each byte only a few times
+	bool grown = false;
+	if (mVertexCount + vertexCount > mVertexCapacity)
+	{
+		GLsizei capacity = glm::max(mVertexCapacity * 2, mVertexCount + vertexCount);
+		growBuffer(mVBO, (GLsizeiptr)mVertexCount * mLayout.stride, (GLsizeiptr)capacity * mLayout.stride);
+		mVertexCapacity = capacity;
+		grown = true;
+	}
+	if (mIndexCount + indexCount > mIndexCapacity)
+	{
+		GLsizei capacity = glm::max(mIndexCapacity * 2, mIndexCount + indexCount);
+		growBuffer(mIBO, (GLsizeiptr)mIndexCount * sizeof(GLuint), (GLsizeiptr)capacity * sizeof(GLuint));
+		mIndexCapacity = capacity;
+		grown = true;
+	}
+	if (grown)
+		bindBuffers();
+
+	// The arena's index buffer is 32 bit; 16 bit meshes are widened
+	std::vector<GLuint> wideIndices;
+	if (indexSize == sizeof(GLushort))
+	{
+		const GLushort* shortIndices = (const GLushort*)indexData;
+		wideIndices.assign(shortIndices, shortIndices + indexCount);
+		indexData = wideIndices.data();
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)mVertexCount * mLayout.stride, (GLsizeiptr)vertexCount * mLayout.stride, vertexData);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// GL_COPY_WRITE_BUFFER instead of GL_ELEMENT_ARRAY_BUFFER, which would change the bound VAO
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mIBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)mIndexCount * sizeof(GLuint), (GLsizeiptr)indexCount * sizeof(GLuint), indexData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	baseVertex = mVertexCount;
+	firstIndex = mIndexCount;
+	mVertexCount += vertexCount;
+	mIndexCount += indexCount;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Queues one draw of an arena mesh for the next flush
+//-----------------------------------------------------------------------------
+void MeshArena::addDraw(const Mesh& mesh, GLuint lod, const glm::mat4& model, GLint layer, const glm::vec4& uvTransform)
+{
+	if (mesh.getArena() != this)
+		return;
+
+	const MeshLOD& range = mesh.getLOD(lod);
+	DrawElementsIndirectCommand command = { range.indexCount, 1, range.firstIndex, mesh.getBaseVertex(), (GLuint)mCommands.size() };
+	mCommands.push_back(command);
+
+	const VertexDequantization& dequantization = mesh.getDequantization();
+	for (int column = 0; column < 4; column++)
+		mDrawData.push_back(model[column]);
+	mDrawData.push_back(glm::vec4(dequantization.positionOffset, (float)layer));
+	mDrawData.push_back(glm::vec4(dequantization.positionScale, 0.0f));
+
+	// Atlas region applied on top of the dequantization
+	glm::vec2 uvOffset = dequantization.texCoordOffset, uvScale = dequantization.texCoordScale;
+	TextureAtlas::applyTransform(uvTransform, uvOffset, uvScale);
+	mDrawData.push_back(glm::vec4(uvOffset, uvScale));
+}
+
+//-----------------------------------------------------------------------------
+// Uploads the queued draws' data and issues them all, then empties the queue.
+// The batched program must be in use and the draw data sampler set to textureUnit.
+//-----------------------------------------------------------------------------
+void MeshArena::flush(GLuint textureUnit)
+{
+	GLsizei drawCount = (GLsizei)mCommands.size();
+	if (drawCount == 0)
+		return;
+
+	// Draw data and commands go to the frame's dynamic buffer when there's room
+	GLsizeiptr drawDataBytes = mDrawData.size() * sizeof(glm::vec4);
+	DynamicSlice drawData, commands;
+	bool dynamicData = mDynamic != NULL && mTextureBufferRange &&
+		mDynamic->write(mDrawData.data(), drawDataBytes, mTextureBufferAlignment, drawData);
+	bool dynamicCommands = mDynamic != NULL && mIndirect &&
+		mDynamic->write(mCommands.data(), drawCount * sizeof(DrawElementsIndirectCommand), sizeof(GLuint), commands);
+	if (dynamicData || dynamicCommands)
+		mDynamic->flush();
+
+	GLState::bindTexture(GL_TEXTURE_BUFFER, textureUnit, mDrawDataTexture);
+	if (dynamicData)
+		glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, drawData.buffer, drawData.offset, drawData.size);
+	else
+	{
+		// Draw data is orphaned and refilled each flush
+		glBindBuffer(GL_TEXTURE_BUFFER, mDrawDataBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, drawDataBytes, mDrawData.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		// glTexBuffer is only needed once, but the buffer is reallocated, so attach again
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mDrawDataBuffer);
+	}
+
+	GLState::bindVertexArray(mVAO);
+
+	if (mIndirect)
+	{
+		// Draw IDs 0..n-1, only rewritten when there are more draws than ever before
+		if (drawCount > mDrawCapacity)
+		{
+			std::vector<GLuint> drawIds(drawCount);
+			for (GLsizei i = 0; i < drawCount; i++)
+				drawIds[i] = i;
+
+			glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+			glBufferData(GL_ARRAY_BUFFER, drawCount * sizeof(GLuint), drawIds.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			mDrawCapacity = drawCount;
+		}
+
+		if (dynamicCommands)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+		else
+		{
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCount * sizeof(DrawElementsIndirectCommand), mCommands.data(), GL_STREAM_DRAW);
+		}
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)(dynamicCommands ? commands.offset : 0), drawCount, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else
+	{
+		for (GLsizei i = 0; i < drawCount; i++)
+		{
+			const DrawElementsIndirectCommand& command = mCommands[i];
+			glVertexAttribI1ui(DRAW_ID_ATTRIBUTE_LOCATION, i);
+			glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+				(GLvoid*)(command.firstIndex * sizeof(GLuint)), command.baseVertex);
+		}
+	}
+
+	mCommands.clear();
+	mDrawData.clear();
+}
@@ -0,0 +1,108 @@
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+#include <vector>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+class DynamicBuffer;
+
+
+// Per-draw index read by the batched vertex shader (after the instance matrix, 3..6)
+const GLuint DRAW_ID_ATTRIBUTE_LOCATION = 7;
+
+// Texels (RGBA32F) of per-draw data: model matrix columns, position
+// offset (w: texture array layer, -1 for none), position scale, uv
+// offset and scale
+const GLuint DRAW_DATA_TEXELS = 7;
+
+// Layout of glMultiDrawElementsIndirect's command buffer
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+//--------------------------------------------------------------
+// Mesh Arena
+//
+// One vertex buffer, one 32 bit index buffer and one VAO shared by
+// every mesh loaded into it (see Mesh::setArena), so drawing any of
+// them needs no VAO switch.  Meshes keep their own indices and are
+// drawn with a base vertex; all of them must use the arena's vertex
+// format.  The buffers grow by copying when a mesh doesn't fit.
+//
+// Draws added with addDraw() are issued by flush() as a single
+// glMultiDrawElementsIndirect when GL 4.3 / ARB_multi_draw_indirect
+// and ARB_base_instance are available.  Each command's base instance
+// is its draw index, which an instanced attribute (divisor 1, values
+// 0..n-1) hands to the shader as the draw ID.  Without indirect
+// draws, flush() sets the draw ID as a constant attribute and calls
+// glDrawElementsBaseVertex per draw: still no state change between
+// draws.  The shader fetches the model matrix and dequantization of
+// its draw from a texture buffer.
+//
+// With a DynamicBuffer set, flush() writes the draw data and the
+// indirect commands into it instead of reallocating its own
+// buffers; the draw data needs GL 4.3 / ARB_texture_buffer_range
+// for that, since its texture buffer then starts at an offset.
+//--------------------------------------------------------------
+class MeshArena
+{
+public:
+
+	MeshArena();
+	~MeshArena();
+
+	bool create(VertexFormat format, GLsizei vertexCapacity, GLsizei indexCapacity);
+
+	// Copies a mesh into the arena; indexSize is 2 or 4 bytes
+	bool allocate(const void* vertexData, GLsizei vertexCount, const void* indexData, GLsizei indexCount,
+		GLuint indexSize, GLint& baseVertex, GLuint& firstIndex);
+
+	VertexFormat getVertexFormat() const { return mFormat; }
+	GLuint getVertexArray() const { return mVAO; }
+	bool hasIndirectDraw() const { return mIndirect; }
+
+	// Batched drawing: queue draws, then issue them all with the draw data on textureUnit.
+	// layer picks a TextureArray layer; uvTransform maps the mesh's uvs into an
+	// atlas region (atlas uv = xy + zw * uv, see TextureAtlas).
+	void addDraw(const Mesh& mesh, GLuint lod, const glm::mat4& model, GLint layer = -1,
+		const glm::vec4& uvTransform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	void flush(GLuint textureUnit);
+
+	// Per-frame buffer flush() writes into, NULL for none; it must be between beginFrame and endFrame
+	void setDynamicBuffer(DynamicBuffer* buffer) { mDynamic = buffer; }
+	size_t getDrawCount() const { return mCommands.size(); }
+
+private:
+
+	void growBuffer(GLuint& buffer, GLsizeiptr usedBytes, GLsizeiptr newBytes);
+	void bindBuffers();
+
+	VertexFormat mFormat;
+	VertexLayout mLayout;
+	bool mIndirect;
+
+	GLuint mVAO, mVBO, mIBO;
+	GLsizei mVertexCount, mVertexCapacity;
+	GLsizei mIndexCount, mIndexCapacity;
+
+	std::vector<DrawElementsIndirectCommand> mCommands;
+	std::vector<glm::vec4> mDrawData;
+	GLuint mIndirectBuffer;
+	GLuint mDrawIdBuffer;
+	GLsizei mDrawCapacity;
+	GLuint mDrawDataBuffer;
+	GLuint mDrawDataTexture;
+
+	DynamicBuffer* mDynamic;
+	bool mTextureBufferRange;
+	GLsizeiptr mTextureBufferAlignment;
+};
+#endif //MESHARENA_H
@@ -0,0 +1,174 @@
+#include "MeshCache.h"
+#include "VertexPacker.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+static const unsigned long long BLOB_ALIGNMENT = 16;
+
+static inline unsigned long long alignUp(unsigned long long offset)
+{
+	return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+}
+
+//-----------------------------------------------------------------------------
+// Gets the size and modification time of a file
+//-----------------------------------------------------------------------------
+static bool getFileInfo(const std::string& filename, unsigned long long& size, unsigned long long& time)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return false;
+
+	size = (unsigned long long)st.st_size;
+	time = (unsigned long long)st.st_mtime;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+MeshCache::MeshCache()
+	: mHeader(NULL)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Maps the cache of a source file if there is one, it is up to date and it
+// was built with the same vertex format, flags and number of LODs
+//-----------------------------------------------------------------------------
+bool MeshCache::open(const std::string& sourceFile, VertexFormat format, GLuint flags, GLuint lodCount)
+{
+	close();
+
+	unsigned long long sourceSize, sourceTime;
+	if (!getFileInfo(sourceFile, sourceSize, sourceTime))
+		return false;
+
+	std::string cachePath = getCachePath(sourceFile, format, flags, lodCount);
+	if (!mFile.open(cachePath) || mFile.size() < sizeof(MeshCacheHeader))
+	{
+		close();
+		return false;
+	}
+
+	const MeshCacheHeader* header = (const MeshCacheHeader*)mFile.data();
+	VertexLayout layout = VertexPacker::getLayout(format);
+
+	bool valid = header->magic == MESH_CACHE_MAGIC &&
+		header->version == MESH_CACHE_VERSION &&
+		header->sourceSize == sourceSize &&
+		header->sourceTime == sourceTime &&
+		header->flags == flags &&
+		header->lodCount == lodCount &&
+		header->vertexFormat == (GLuint)format &&
+		memcmp(&header->layout, &layout, sizeof(layout)) == 0 &&
+		header->vertexOffset + (unsigned long long)header->vertexCount * header->layout.stride <= mFile.size() &&
+		header->indexOffset + (unsigned long long)header->indexCount * header->indexSize <= mFile.size();
+
+	for (GLuint i = 0; valid && i < lodCount; i++)
+		valid = header->lods[i].firstIndex + (unsigned long long)header->lods[i].indexCount <= header->indexCount;
+
+	if (!valid)
+	{
+		close();
+		return false;
+	}
+
+	mHeader = header;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Unmaps the cache
+//-----------------------------------------------------------------------------
+void MeshCache::close()
+{
+	mFile.close();
+	mHeader = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the vertex blob of an open cache
+//-----------------------------------------------------------------------------
+const void* MeshCache::getVertexData() const
+{
+	return mFile.data() + mHeader->vertexOffset;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the index blob of an open cache, NULL if the mesh isn't indexed
+//-----------------------------------------------------------------------------
+const void* MeshCache::getIndexData() const
+{
+	return mHeader->indexCount > 0 ? mFile.data() + mHeader->indexOffset : NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the cache of a source file.  The caller fills in the vertex format,
+// layout, dequantization, counts, index size, flags, LODs and bounds of header;
+// the rest is filled in here.  Failing to write (e.g. read-only directory)
+// only means the next load parses the source again.
+//-----------------------------------------------------------------------------
+bool MeshCache::write(const std::string& sourceFile, const MappedFile& source, MeshCacheHeader header,
+	const void* vertexData, const void* indexData)
+{
+	if (!getFileInfo(sourceFile, header.sourceSize, header.sourceTime))
+		return false;
+
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = hash(source.data(), source.size());
+
+	if (header.indexCount == 0)
+		header.indexSize = 0;
+
+	unsigned long long vertexBytes = (unsigned long long)header.vertexCount * header.layout.stride;
+	header.vertexOffset = alignUp(sizeof(header));
+	header.indexOffset = alignUp(header.vertexOffset + vertexBytes);
+
+	std::string cachePath = getCachePath(sourceFile, (VertexFormat)header.vertexFormat, header.flags, header.lodCount);
+	std::ofstream fout(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fout)
+		return false;
+
+	const char padding[BLOB_ALIGNMENT] = { 0 };
+	fout.write((const char*)&header, sizeof(header));
+	fout.write(padding, header.vertexOffset - sizeof(header));
+	fout.write((const char*)vertexData, vertexBytes);
+	if (header.indexCount > 0)
+	{
+		fout.write(padding, header.indexOffset - (header.vertexOffset + vertexBytes));
+		fout.write((const char*)indexData, (std::streamsize)header.indexCount * header.indexSize);
+	}
+
+	return !fout.fail();
+}
+
+//-----------------------------------------------------------------------------
+// Returns the path of the cache of a source file loaded with these settings
+//-----------------------------------------------------------------------------
+std::string MeshCache::getCachePath(const std::string& sourceFile, VertexFormat format, GLuint flags, GLuint lodCount)
+{
+	std::ostringstream path;
+	path << sourceFile << "." << (GLuint)format << "-" << lodCount << "-" << flags << ".meshcache";
+	return path.str();
+}
+
+//-----------------------------------------------------------------------------
+// 64 bit FNV-1a hash of the source contents.  Not needed to validate the
+// cache (size and time are), but identifies what it was built from.
+//-----------------------------------------------------------------------------
+unsigned long long MeshCache::hash(const char* data, size_t size)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= (unsigned char)data[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
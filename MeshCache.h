@@ -0,0 +1,91 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <vector>
+#include <string>
+
+#include "GL/glew.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+
+
+//--------------------------------------------------------------
+// Binary mesh cache file layout
+//
+// A header, followed by the vertex blob and the index blob, each
+// starting on a 16 byte boundary.  The blobs are exactly what gets
+// handed to glBufferData (vertices already in their VertexFormat),
+// so a mapped cache needs no processing.
+//--------------------------------------------------------------
+const GLuint MESH_CACHE_MAGIC = 0x4853454D;	// "MESH"
+const GLuint MESH_CACHE_VERSION = 5;
+
+// How the cached data was processed; a cache is only used for the same flags
+const GLuint MESH_CACHE_OPTIMIZED = 1 << 0;
+
+struct MeshCacheHeader
+{
+	GLuint magic;
+	GLuint version;
+
+	// Source file the cache was built from
+	unsigned long long sourceSize;
+	unsigned long long sourceTime;
+	unsigned long long sourceHash;
+
+	// Vertex layout descriptor
+	GLuint vertexFormat;
+	VertexLayout layout;
+	VertexDequantization dequantization;
+
+	GLuint vertexCount;
+	GLuint indexCount;
+	GLuint indexSize;	// 0 (not indexed), 2 or 4 bytes
+	GLuint flags;
+
+	// Index ranges of the levels of detail
+	GLuint lodCount;
+	MeshLOD lods[MAX_MESH_LODS];
+
+	MeshBounds bounds;
+
+	unsigned long long vertexOffset;
+	unsigned long long indexOffset;
+};
+
+//--------------------------------------------------------------
+// Mesh Cache
+//
+// Sidecar next to a model, written after the model is first
+// parsed and used instead of it while the model's size and
+// modification time still match.  The vertex format, flags and
+// LOD count are part of the name ("<model>.<format>-<lods>-<flags>
+// .meshcache"), so a model loaded with several settings keeps a
+// cache for each.
+//--------------------------------------------------------------
+class MeshCache
+{
+public:
+	MeshCache();
+
+	bool open(const std::string& sourceFile, VertexFormat format, GLuint flags, GLuint lodCount);
+	void close();
+
+	const MeshCacheHeader& getHeader() const { return *mHeader; }
+	const void* getVertexData() const;
+	const void* getIndexData() const;
+
+	static bool write(const std::string& sourceFile, const MappedFile& source, MeshCacheHeader header,
+		const void* vertexData, const void* indexData);
+
+	static std::string getCachePath(const std::string& sourceFile, VertexFormat format, GLuint flags, GLuint lodCount);
+	static unsigned long long hash(const char* data, size_t size);
+
+private:
+	MeshCache(const MeshCache& rhs);
+	MeshCache& operator = (const MeshCache& rhs);
+
+	MappedFile mFile;
+	const MeshCacheHeader* mHeader;
+};
+#endif //MESHCACHE_H
@@ -0,0 +1,342 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <algorithm>
+
+
+// Out-of-line definition: std::min binds CACHE_SIZE to a reference
+const unsigned int MeshOptimizer::CACHE_SIZE;
+
+// Forsyth's scoring constants, tuned for a 32 entry LRU cache
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+// Overdraw clusters may cost this much more ACMR than the cache order they come from
+static const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+//-----------------------------------------------------------------------------
+// Score of a vertex from its LRU cache position (-1 if not cached) and the
+// number of triangles that still use it
+//-----------------------------------------------------------------------------
+static float vertexScore(int cachePosition, unsigned int remaining)
+{
+	if (remaining == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle's vertices get a fixed score so it isn't repeated straight away
+		if (cachePosition < 3)
+			score = LAST_TRIANGLE_SCORE;
+		else
+			score = powf(1.0f - (float)(cachePosition - 3) / (MeshOptimizer::CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+
+	// Favour vertices with few triangles left so they get finished off
+	score += VALENCE_BOOST_SCALE * powf((float)remaining, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+//-----------------------------------------------------------------------------
+// FIFO cache simulation step.  Returns 1 if vertex v had to be transformed.
+//-----------------------------------------------------------------------------
+static inline unsigned int updateCache(GLuint v, std::vector<unsigned int>& cacheTime, unsigned int& time, unsigned int cacheSize)
+{
+	if (time - cacheTime[v] > cacheSize)
+	{
+		cacheTime[v] = time++;
+		return 1;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Reorders the triangles for the post-transform vertex cache using Tom
+// Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily emit the
+// triangle with the best score among those touching cached vertices.
+//-----------------------------------------------------------------------------
+void MeshOptimizer::optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles using each vertex, packed into one array
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vScore[v] = vertexScore(-1, remaining[v]);
+
+	std::vector<float> tScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++)
+		tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+
+	std::vector<GLuint> result;
+	result.reserve(triangleCount * 3);
+
+	GLuint cache[CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	size_t scanCursor = 0;
+
+	int best = (int)(std::max_element(tScore.begin(), tScore.end()) - tScore.begin());
+
+	while (best >= 0)
+	{
+		const GLuint* tri = &indices[best * 3];
+		emitted[best] = true;
+		result.insert(result.end(), tri, tri + 3);
+
+		// Take the triangle out of its vertices' adjacency lists
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = tri[k];
+			unsigned int* list = &adjacency[firstTriangle[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == (unsigned int)best)
+				{
+					list[i] = list[remaining[v] - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache
+		GLuint newCache[CACHE_SIZE + 3];
+		unsigned int newCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(newCache, newCache + newCount, tri[k]) == newCache + newCount)
+				newCache[newCount++] = tri[k];
+		}
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			if (std::find(newCache, newCache + newCount, cache[i]) == newCache + newCount)
+				newCache[newCount++] = cache[i];
+		}
+
+		// Rescore everything that moved, including what just fell out of the cache
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			GLuint v = newCache[i];
+			cachePosition[v] = (i < CACHE_SIZE) ? (int)i : -1;
+
+			float score = vertexScore(cachePosition[v], remaining[v]);
+			float delta = score - vScore[v];
+			vScore[v] = score;
+
+			for (unsigned int j = 0; j < remaining[v]; j++)
+				tScore[adjacency[firstTriangle[v] + j]] += delta;
+		}
+
+		cacheCount = std::min(newCount, CACHE_SIZE);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// Next triangle: the best one touching the cache...
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			GLuint v = cache[i];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				unsigned int t = adjacency[firstTriangle[v] + j];
+				if (tScore[t] > bestScore)
+				{
+					bestScore = tScore[t];
+					best = (int)t;
+				}
+			}
+		}
+
+		// ...or, when the cache has nothing left to offer, the next one not yet emitted
+		if (best < 0)
+		{
+			while (scanCursor < triangleCount && emitted[scanCursor])
+				scanCursor++;
+			if (scanCursor < triangleCount)
+				best = (int)scanCursor;
+		}
+	}
+
+	indices.swap(result);
+}
+
+//-----------------------------------------------------------------------------
+// Reorders clusters of triangles so the ones facing outwards from the mesh
+// centre are drawn first and occlude the rest (Sander et al., "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw").
+// Clusters are cut where the vertex cache order allows it without raising
+// ACMR by more than OVERDRAW_ACMR_THRESHOLD, so run this after
+// optimizeVertexCache.
+//-----------------------------------------------------------------------------
+void MeshOptimizer::optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<unsigned int> cacheTime(vertices.size(), 0);
+	unsigned int time = CACHE_SIZE + 1;
+
+	// Hard boundaries: triangles whose three vertices all miss the cache
+	std::vector<size_t> hardClusters;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		unsigned int misses = updateCache(indices[t * 3], cacheTime, time, CACHE_SIZE) +
+			updateCache(indices[t * 3 + 1], cacheTime, time, CACHE_SIZE) +
+			updateCache(indices[t * 3 + 2], cacheTime, time, CACHE_SIZE);
+		if (t == 0 || misses == 3)
+			hardClusters.push_back(t);
+	}
+	hardClusters.push_back(triangleCount);
+
+	// Soft boundaries: restart the cache as soon as the running ACMR from a
+	// cold cache is back within the threshold of the whole hard cluster's
+	std::vector<size_t> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+	{
+		size_t start = hardClusters[c], end = hardClusters[c + 1];
+
+		time += CACHE_SIZE + 1;
+		unsigned int clusterMisses = 0;
+		for (size_t i = start * 3; i < end * 3; i++)
+			clusterMisses += updateCache(indices[i], cacheTime, time, CACHE_SIZE);
+		float threshold = OVERDRAW_ACMR_THRESHOLD * clusterMisses / (end - start);
+
+		size_t t = start;
+		while (t < end)
+		{
+			clusters.push_back(t);
+
+			time += CACHE_SIZE + 1;
+			unsigned int misses = 0;
+			size_t first = t;
+			while (t < end)
+			{
+				for (int k = 0; k < 3; k++)
+					misses += updateCache(indices[t * 3 + k], cacheTime, time, CACHE_SIZE);
+				t++;
+				if ((float)misses / (t - first) <= threshold)
+					break;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	glm::vec3 meshCentroid;
+	for (size_t v = 0; v < vertices.size(); v++)
+		meshCentroid += vertices[v].position;
+	meshCentroid /= (float)std::max((size_t)1, vertices.size());
+
+	// Sort key: how far the cluster faces away from the mesh centre
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKey(clusterCount);
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		glm::vec3 centroid, normal;
+		float area = 0.0f;
+
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3]].position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float a = glm::length(n);
+
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		if (area > 0.0f)
+			centroid /= area;
+
+		float length = glm::length(normal);
+		sortKey[c] = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+		order[c] = c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<GLuint> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i < clusterCount; i++)
+	{
+		size_t c = order[i];
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+
+	indices.swap(result);
+}
+
+//-----------------------------------------------------------------------------
+// Renumbers the vertices in the order the triangles first use them so the
+// vertex fetch walks memory linearly.  Unused vertices are dropped.
+//-----------------------------------------------------------------------------
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	const GLuint UNUSED = 0xFFFFFFFF;
+	std::vector<GLuint> remap(vertices.size(), UNUSED);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		GLuint& v = indices[i];
+		if (remap[v] == UNUSED)
+		{
+			remap[v] = (GLuint)result.size();
+			result.push_back(vertices[v]);
+		}
+		v = remap[v];
+	}
+
+	vertices.swap(result);
+}
+
+//-----------------------------------------------------------------------------
+// Simulates a FIFO post-transform cache of cacheSize entries
+//-----------------------------------------------------------------------------
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int time = cacheSize + 1;
+	size_t transformed = 0, unique = 0;
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		transformed += updateCache(indices[i], cacheTime, time, cacheSize);
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			unique++;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = indices.size() >= 3 ? (float)transformed / (indices.size() / 3) : 0.0f;
+	stats.atvr = unique > 0 ? (float)transformed / unique : 0.0f;
+	return stats;
+}
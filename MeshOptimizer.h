@@ -0,0 +1,43 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+
+#include "GL/glew.h"
+#include "Mesh.h"
+
+
+//--------------------------------------------------------------
+// Post-transform vertex cache statistics of an index buffer,
+// measured with a FIFO cache simulation.
+//   ACMR - transformed vertices per triangle (0.5 .. 3)
+//   ATVR - transformed vertices per unique vertex (1 is ideal)
+//--------------------------------------------------------------
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+//--------------------------------------------------------------
+// Mesh Optimizer
+//
+// Reorders indexed triangle lists so the GPU transforms and fetches
+// fewer vertices.  Run after loading and before uploading:
+//   1. optimizeVertexCache - Forsyth's linear-speed triangle order
+//   2. optimizeOverdraw    - sorts cache-friendly clusters outside-in
+//   3. optimizeVertexFetch - renumbers vertices in first-use order
+//--------------------------------------------------------------
+class MeshOptimizer
+{
+public:
+
+	static const unsigned int CACHE_SIZE = 32;
+
+	static void optimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+	static void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<Vertex>& vertices);
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	static VertexCacheStats analyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE);
+};
+#endif //MESHOPTIMIZER_H
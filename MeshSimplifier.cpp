@@ -0,0 +1,389 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+
+// Open borders weigh this much more than surface planes in the error
+static const double BORDER_WEIGHT = 10.0;
+
+enum VertexKind
+{
+	KIND_MANIFOLD,	// interior vertex, may collapse onto any neighbour
+	KIND_BORDER,	// on a simple open border, may only slide along it
+	KIND_SEAM,		// on a simple attribute seam (two wedges), may only slide along it
+	KIND_LOCKED		// on a seam corner, a complex border or both
+};
+
+//-----------------------------------------------------------------------------
+// Error quadric: error(p) = p'Ap + 2b'p + c
+//-----------------------------------------------------------------------------
+struct Quadric
+{
+	double a00, a11, a22, a01, a02, a12;
+	double b0, b1, b2;
+	double c;
+};
+
+static void addPlane(Quadric& q, const glm::dvec3& n, double d, double weight)
+{
+	q.a00 += weight * n.x * n.x;
+	q.a11 += weight * n.y * n.y;
+	q.a22 += weight * n.z * n.z;
+	q.a01 += weight * n.x * n.y;
+	q.a02 += weight * n.x * n.z;
+	q.a12 += weight * n.y * n.z;
+	q.b0 += weight * n.x * d;
+	q.b1 += weight * n.y * d;
+	q.b2 += weight * n.z * d;
+	q.c += weight * d * d;
+}
+
+static void addQuadric(Quadric& q, const Quadric& r)
+{
+	q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+	q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+	q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+	q.c += r.c;
+}
+
+static double evaluate(const Quadric& q, const glm::dvec3& p)
+{
+	double error = p.x * p.x * q.a00 + p.y * p.y * q.a11 + p.z * p.z * q.a22 +
+		2.0 * (p.x * p.y * q.a01 + p.x * p.z * q.a02 + p.y * p.z * q.a12) +
+		2.0 * (p.x * q.b0 + p.y * q.b1 + p.z * q.b2) + q.c;
+	return error > 0.0 ? error : 0.0;
+}
+
+struct Collapse
+{
+	double error;
+	GLuint from, to;
+
+	bool operator < (const Collapse& rhs) const { return error < rhs.error; }
+};
+
+struct PositionHash
+{
+	size_t operator () (const glm::vec3& p) const
+	{
+		unsigned int h[3];
+		memcpy(h, &p[0], sizeof(h));
+		return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+	}
+};
+
+static inline unsigned long long edgeKey(GLuint a, GLuint b)
+{
+	return ((unsigned long long)a << 32) | b;
+}
+
+static const GLuint NO_WEDGE = 0xFFFFFFFF;
+
+//-----------------------------------------------------------------------------
+// Finds the vertex at position p that shares a triangle with vertex v
+//-----------------------------------------------------------------------------
+static GLuint findWedge(GLuint v, GLuint p, const std::vector<GLuint>& indices,
+	const std::vector<unsigned int>& firstTriangle, const std::vector<unsigned int>& adjacency,
+	const std::vector<GLuint>& position)
+{
+	for (unsigned int j = firstTriangle[v]; j < firstTriangle[v + 1]; j++)
+	{
+		const GLuint* tri = &indices[adjacency[j] * 3];
+		for (int k = 0; k < 3; k++)
+		{
+			if (position[tri[k]] == p)
+				return tri[k];
+		}
+	}
+	return NO_WEDGE;
+}
+
+//-----------------------------------------------------------------------------
+// Checks whether moving vertex "from" onto "to" flips any triangle around it,
+// and counts the triangles the move would collapse
+//-----------------------------------------------------------------------------
+static bool flips(GLuint from, GLuint to, const std::vector<GLuint>& indices,
+	const std::vector<unsigned int>& firstTriangle, const std::vector<unsigned int>& adjacency,
+	const std::vector<GLuint>& position, const std::vector<glm::dvec3>& positions, size_t& degenerate)
+{
+	for (unsigned int j = firstTriangle[from]; j < firstTriangle[from + 1]; j++)
+	{
+		const GLuint* tri = &indices[adjacency[j] * 3];
+		int k0 = (tri[0] == from) ? 0 : (tri[1] == from) ? 1 : 2;
+		GLuint a = tri[(k0 + 1) % 3], b = tri[(k0 + 2) % 3];
+
+		if (position[a] == position[to] || position[b] == position[to])
+		{
+			degenerate++;
+			continue;
+		}
+
+		glm::dvec3 before = glm::cross(positions[a] - positions[from], positions[b] - positions[from]);
+		glm::dvec3 after = glm::cross(positions[a] - positions[to], positions[b] - positions[to]);
+		if (glm::dot(before, after) <= 1e-2 * glm::length(before) * glm::length(after))
+			return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Simplifies the triangle list in passes.  Each pass collects the possible
+// edge collapses, sorts them by quadric error and applies the cheapest ones
+// that don't touch a vertex already moved in the pass or flip a triangle.
+//-----------------------------------------------------------------------------
+std::vector<GLuint> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+	size_t targetIndexCount, float targetError)
+{
+	std::vector<GLuint> result(indices);
+	size_t vertexCount = vertices.size();
+	if (vertexCount == 0 || indices.size() <= targetIndexCount)
+		return result;
+
+	// Positions scaled to a unit box so the error doesn't depend on model size
+	glm::vec3 minPos = vertices[0].position, maxPos = minPos;
+	for (size_t v = 1; v < vertexCount; v++)
+	{
+		minPos = glm::min(minPos, vertices[v].position);
+		maxPos = glm::max(maxPos, vertices[v].position);
+	}
+	glm::vec3 extent = maxPos - minPos;
+	double scale = 1.0 / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+
+	std::vector<glm::dvec3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		positions[v] = glm::dvec3(vertices[v].position - minPos) * scale;
+
+	// Vertices sharing a position are the wedges of one position; position[v] is the
+	// first of them and nextWedge links each position's wedges in a ring
+	std::vector<GLuint> position(vertexCount), nextWedge(vertexCount);
+	std::vector<unsigned int> wedges(vertexCount, 0);
+	{
+		std::unordered_map<glm::vec3, GLuint, PositionHash> firstWedge;
+		firstWedge.reserve(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			GLuint first = firstWedge.insert(std::make_pair(vertices[v].position, (GLuint)v)).first->second;
+			position[v] = first;
+			wedges[first]++;
+
+			nextWedge[v] = (GLuint)v;
+			if (first != v)
+				std::swap(nextWedge[v], nextWedge[first]);
+		}
+	}
+
+	// Open (unpaired) half-edges between positions are borders
+	std::unordered_set<unsigned long long> halfEdges;
+	halfEdges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+			halfEdges.insert(edgeKey(position[result[i + k]], position[result[i + (k + 1) % 3]]));
+	}
+
+	std::vector<unsigned int> openOut(vertexCount, 0), openIn(vertexCount, 0);
+	std::unordered_set<unsigned long long> borderEdges;
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint a = position[result[i + k]], b = position[result[i + (k + 1) % 3]];
+			if (halfEdges.count(edgeKey(b, a)) == 0)
+			{
+				openOut[a]++;
+				openIn[b]++;
+				borderEdges.insert(edgeKey(a, b));
+				borderEdges.insert(edgeKey(b, a));
+			}
+		}
+	}
+
+	// Open half-edges between vertices that are paired between positions are seams
+	std::unordered_set<unsigned long long> vertexEdges;
+	vertexEdges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+			vertexEdges.insert(edgeKey(result[i + k], result[i + (k + 1) % 3]));
+	}
+
+	std::vector<unsigned int> seamOut(vertexCount, 0), seamIn(vertexCount, 0);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint a = result[i + k], b = result[i + (k + 1) % 3];
+			if (vertexEdges.count(edgeKey(b, a)) == 0 && halfEdges.count(edgeKey(position[b], position[a])) != 0)
+			{
+				seamOut[a]++;
+				seamIn[b]++;
+			}
+		}
+	}
+
+	std::vector<unsigned char> kind(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		GLuint p = position[v];
+		if (wedges[p] > 1)
+		{
+			bool simpleSeam = wedges[p] == 2 && openOut[p] == 0 && openIn[p] == 0 && seamOut[v] == 1 && seamIn[v] == 1;
+			kind[v] = simpleSeam ? KIND_SEAM : KIND_LOCKED;
+		}
+		else if (openOut[p] == 0 && openIn[p] == 0)
+			kind[v] = KIND_MANIFOLD;
+		else if (openOut[p] == 1 && openIn[p] == 1)
+			kind[v] = KIND_BORDER;
+		else
+			kind[v] = KIND_LOCKED;
+	}
+
+	// Per-position quadrics from the triangle planes (area weighted) and,
+	// along open borders, from planes perpendicular to the triangle
+	std::vector<Quadric> quadrics(vertexCount);
+	memset(&quadrics[0], 0, vertexCount * sizeof(Quadric));
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const glm::dvec3& p0 = positions[result[i]];
+		const glm::dvec3& p1 = positions[result[i + 1]];
+		const glm::dvec3& p2 = positions[result[i + 2]];
+
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double area = glm::length(normal);
+		if (area <= 0.0)
+			continue;
+		normal /= area;
+
+		for (int k = 0; k < 3; k++)
+			addPlane(quadrics[position[result[i + k]]], normal, -glm::dot(normal, p0), area * 0.5);
+
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint a = position[result[i + k]], b = position[result[i + (k + 1) % 3]];
+			if (halfEdges.count(edgeKey(b, a)) != 0)
+				continue;
+
+			glm::dvec3 edge = positions[b] - positions[a];
+			double length = glm::length(edge);
+			glm::dvec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+			double d = -glm::dot(edgeNormal, positions[a]);
+			addPlane(quadrics[a], edgeNormal, d, length * length * BORDER_WEIGHT);
+			addPlane(quadrics[b], edgeNormal, d, length * length * BORDER_WEIGHT);
+		}
+	}
+
+	double errorLimit = (double)targetError * targetError;
+
+	std::vector<GLuint> remap(vertexCount);
+	std::vector<bool> moved(vertexCount);
+	std::vector<unsigned int> firstTriangle(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+
+	while (result.size() > targetIndexCount)
+	{
+		// Triangles around each vertex
+		std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+		for (size_t i = 0; i < result.size(); i++)
+			firstTriangle[result[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			firstTriangle[v + 1] += firstTriangle[v];
+		adjacency.resize(result.size());
+		std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+			adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+
+		// Candidate collapses along every edge, in both directions
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint v0 = result[i + k], v1 = result[i + (k + 1) % 3];
+				for (int dir = 0; dir < 2; dir++, std::swap(v0, v1))
+				{
+					if (kind[v0] == KIND_LOCKED)
+						continue;
+					if (kind[v0] == KIND_BORDER &&
+						(kind[v1] == KIND_MANIFOLD || borderEdges.count(edgeKey(position[v0], position[v1])) == 0))
+						continue;
+					if (kind[v0] == KIND_SEAM &&
+						(kind[v1] == KIND_MANIFOLD || kind[v1] == KIND_BORDER || vertexEdges.count(edgeKey(v1, v0)) != 0))
+						continue;
+
+					Quadric q = quadrics[position[v0]];
+					addQuadric(q, quadrics[position[v1]]);
+
+					Collapse collapse = { evaluate(q, positions[v1]), v0, v1 };
+					if (collapse.error <= errorLimit)
+						collapses.push_back(collapse);
+				}
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end());
+
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = (GLuint)v;
+		std::fill(moved.begin(), moved.end(), false);
+
+		// Each pass goes at most halfway to the target so later passes see fresh errors
+		size_t trianglesLeft = result.size() / 3;
+		size_t targetTriangles = targetIndexCount / 3;
+		size_t passGoal = std::max((size_t)1, (trianglesLeft - targetTriangles + 1) / 2);
+		size_t removed = 0;
+
+		for (size_t c = 0; c < collapses.size() && removed < passGoal; c++)
+		{
+			GLuint v0 = collapses[c].from, v1 = collapses[c].to;
+			if (moved[position[v0]] || moved[position[v1]])
+				continue;
+
+			// A seam vertex moves both its wedges, each onto the wedge of the
+			// target position on the same side of the seam
+			GLuint w0 = v0, w1 = v1;
+			if (kind[v0] == KIND_SEAM)
+			{
+				w0 = nextWedge[v0];
+				w1 = findWedge(w0, position[v1], result, firstTriangle, adjacency, position);
+				if (w1 == NO_WEDGE || w1 == v1)
+					continue;
+			}
+
+			size_t degenerate = 0;
+			if (flips(v0, v1, result, firstTriangle, adjacency, position, positions, degenerate) ||
+				(w0 != v0 && flips(w0, w1, result, firstTriangle, adjacency, position, positions, degenerate)))
+				continue;
+
+			remap[v0] = v1;
+			remap[w0] = w1;
+			addQuadric(quadrics[position[v1]], quadrics[position[v0]]);
+			moved[position[v0]] = moved[position[v1]] = true;
+			removed += degenerate;
+		}
+
+		if (removed == 0)
+			break;
+
+		// Apply the pass and drop the triangles that collapsed
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			GLuint a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (position[a] == position[b] || position[a] == position[c] || position[b] == position[c])
+				continue;
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	return result;
+}
@@ -0,0 +1,31 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+
+#include "GL/glew.h"
+#include "Mesh.h"
+
+
+//--------------------------------------------------------------
+// Mesh Simplifier
+//
+// Reduces an indexed triangle list with quadric error metrics
+// (Garland & Heckbert), collapsing vertices onto neighbouring
+// vertices so the result reuses the original vertex buffer.
+//
+// Attribute seams (a position shared by vertices with different
+// uvs or normals) and open borders only collapse along themselves,
+// moving every vertex of a seam position together; seam corners
+// stay put.  Texture charts and silhouettes are not torn apart.
+//--------------------------------------------------------------
+class MeshSimplifier
+{
+public:
+
+	// Returns the simplified indices; stops at targetIndexCount or when the
+	// error, relative to the mesh size, would exceed targetError
+	static std::vector<GLuint> simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices,
+		size_t targetIndexCount, float targetError);
+};
+#endif //MESHSIMPLIFIER_H
@@ -0,0 +1,575 @@
+#include "ObjLoader.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+
+// Files are only split across threads in pieces of at least this many bytes
+static const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+// Exact powers of ten representable in a double
+static const double POW10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skipSpaces(const char* p, const char* end)
+{
+	while (p < end && isSpace(*p))
+		++p;
+	return p;
+}
+
+static inline const char* skipToken(const char* p, const char* end)
+{
+	while (p < end && !isSpace(*p))
+		++p;
+	return p;
+}
+
+//-----------------------------------------------------------------------------
+// Parses a decimal floating point number starting at p.
+// Returns the position after the number, or p itself if there was none.
+//-----------------------------------------------------------------------------
+static const char* parseFloat(const char* p, const char* end, float& value)
+{
+	const char* start = p;
+	bool negative = false;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		++p;
+	}
+
+	// Up to 19 significant digits fit in the 64 bit mantissa; the rest only move the exponent
+	unsigned long long mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+
+	while (p < end && isDigit(*p))
+	{
+		anyDigit = true;
+		if (significant < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa > 0)
+				significant++;
+		}
+		else
+			exponent++;
+		++p;
+	}
+
+	if (p < end && *p == '.')
+	{
+		++p;
+		while (p < end && isDigit(*p))
+		{
+			anyDigit = true;
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa > 0)
+					significant++;
+				exponent--;
+			}
+			++p;
+		}
+	}
+
+	if (!anyDigit)
+		return start;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* expStart = p++;
+		bool expNegative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			expNegative = (*p == '-');
+			++p;
+		}
+
+		if (p < end && isDigit(*p))
+		{
+			int e = 0;
+			while (p < end && isDigit(*p))
+			{
+				if (e < 10000)
+					e = e * 10 + (*p - '0');
+				++p;
+			}
+			exponent += expNegative ? -e : e;
+		}
+		else
+			p = expStart;	// "1e" is just 1 followed by garbage
+	}
+
+	double result = (double)mantissa;
+	if (mantissa != 0)
+	{
+		while (exponent > 22)
+		{
+			result *= POW10[22];
+			exponent -= 22;
+		}
+		while (exponent < -22)
+		{
+			result /= POW10[22];
+			exponent += 22;
+		}
+		if (exponent >= 0)
+			result *= POW10[exponent];
+		else
+			result /= POW10[-exponent];
+	}
+
+	value = (float)(negative ? -result : result);
+	return p;
+}
+
+//-----------------------------------------------------------------------------
+// Parses a (possibly negative) integer starting at p.
+// Returns the position after the number, or p itself if there was none.
+//-----------------------------------------------------------------------------
+static const char* parseInt(const char* p, const char* end, int& value)
+{
+	const char* start = p;
+	bool negative = false;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		++p;
+	}
+
+	if (p >= end || !isDigit(*p))
+		return start;
+
+	int result = 0;
+	while (p < end && isDigit(*p))
+	{
+		result = result * 10 + (*p - '0');
+		++p;
+	}
+
+	value = negative ? -result : result;
+	return p;
+}
+
+//-----------------------------------------------------------------------------
+// Converts a 1-based OBJ index to 0-based; -1 if absent.
+// Negative (relative) indices depend on how many attributes precede the
+// chunk being parsed, which isn't known yet, so they are resolved against
+// the chunk-local count (possibly going below 0) and stored offset by
+// RELATIVE_INDEX until fixRelativeIndex adds the chunk's base.
+//-----------------------------------------------------------------------------
+static const int RELATIVE_INDEX = -(1 << 30);
+
+static inline int resolveIndex(int index, size_t count)
+{
+	if (index > 0)
+		return index - 1;
+	if (index < 0)
+		return RELATIVE_INDEX + ((int)count + index);
+	return -1;
+}
+
+static inline int fixRelativeIndex(int index, int base)
+{
+	return index < -1 ? base + (index - RELATIVE_INDEX) : index;
+}
+
+// The positions with the smallest and largest x, y and z of a chunk.
+// They give the bounding box and Ritter's initial sphere.
+struct Extremes
+{
+	glm::vec3 minPoint[3];
+	glm::vec3 maxPoint[3];
+	bool empty;
+};
+
+//-----------------------------------------------------------------------------
+// Grows the extremes by a point.  Ties keep the earlier point, so merging
+// chunks in file order gives the same result for any number of threads.
+//-----------------------------------------------------------------------------
+static inline void addExtreme(Extremes& extremes, const glm::vec3& minPoint, const glm::vec3& maxPoint, int axis)
+{
+	if (minPoint[axis] < extremes.minPoint[axis][axis])
+		extremes.minPoint[axis] = minPoint;
+	if (maxPoint[axis] > extremes.maxPoint[axis][axis])
+		extremes.maxPoint[axis] = maxPoint;
+}
+
+static void addExtremes(Extremes& extremes, const Extremes& chunk)
+{
+	if (chunk.empty)
+		return;
+
+	if (extremes.empty)
+	{
+		extremes = chunk;
+		return;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+		addExtreme(extremes, chunk.minPoint[axis], chunk.maxPoint[axis], axis);
+}
+
+//-----------------------------------------------------------------------------
+// Bounding box from the extremes and a bounding sphere with Ritter's
+// algorithm: start from the sphere through the most distant extreme pair and
+// grow it over every position left outside.  The same pass measures the
+// sphere around the box centre, which is tighter for flat or boxy meshes.
+//-----------------------------------------------------------------------------
+static void computeBounds(const Extremes& extremes, const std::vector<glm::vec3>& positions, MeshBounds& bounds)
+{
+	if (extremes.empty)
+	{
+		bounds.boxMin = bounds.boxMax = bounds.sphereCenter = glm::vec3(0.0f);
+		bounds.sphereRadius = 0.0f;
+		return;
+	}
+
+	int widest = 0;
+	float widestDistance = -1.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		bounds.boxMin[axis] = extremes.minPoint[axis][axis];
+		bounds.boxMax[axis] = extremes.maxPoint[axis][axis];
+
+		glm::vec3 d = extremes.maxPoint[axis] - extremes.minPoint[axis];
+		float distance = glm::dot(d, d);
+		if (distance > widestDistance)
+		{
+			widest = axis;
+			widestDistance = distance;
+		}
+	}
+
+	glm::vec3 center = 0.5f * (extremes.minPoint[widest] + extremes.maxPoint[widest]);
+	float radius = 0.5f * sqrtf(widestDistance);
+	float radius2 = radius * radius;
+
+	glm::vec3 boxCenter = 0.5f * (bounds.boxMin + bounds.boxMax);
+	float boxRadius2 = 0.0f;
+
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		glm::vec3 b = positions[i] - boxCenter;
+		boxRadius2 = std::max(boxRadius2, glm::dot(b, b));
+
+		glm::vec3 d = positions[i] - center;
+		float distance2 = glm::dot(d, d);
+		if (distance2 > radius2)
+		{
+			float distance = sqrtf(distance2);
+			float newRadius = 0.5f * (radius + distance);
+			center += d * ((newRadius - radius) / distance);
+			radius = newRadius;
+			radius2 = radius * radius;
+		}
+	}
+
+	float boxRadius = sqrtf(boxRadius2);
+	bounds.sphereCenter = (boxRadius < radius) ? boxCenter : center;
+	bounds.sphereRadius = std::min(boxRadius, radius);
+}
+
+// Where a chunk's attributes and corners start in the merged arrays
+struct ChunkOffsets
+{
+	size_t positions, texCoords, normals, corners;
+};
+
+//-----------------------------------------------------------------------------
+// Parses up to n floats of a "v", "vt" or "vn" record.  Missing values stay 0.
+//-----------------------------------------------------------------------------
+static void parseFloats(const char* p, const char* end, float* out, int n)
+{
+	for (int dim = 0; dim < n; dim++)
+	{
+		p = skipSpaces(p, end);
+		const char* next = parseFloat(p, end, out[dim]);
+		if (next == p)
+			break;
+		p = next;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Parses the corners of an "f" record and triangulates it as a fan
+//-----------------------------------------------------------------------------
+static void parseFace(const char* p, const char* end, ObjData& data)
+{
+	glm::ivec3 first, previous;
+	int count = 0;
+
+	while (true)
+	{
+		p = skipSpaces(p, end);
+		if (p >= end)
+			break;
+
+		int v = 0, vt = 0, vn = 0;
+		p = parseInt(p, end, v);
+		if (p < end && *p == '/')
+		{
+			p = parseInt(p + 1, end, vt);
+			if (p < end && *p == '/')
+				p = parseInt(p + 1, end, vn);
+		}
+		p = skipToken(p, end);
+
+		glm::ivec3 corner(resolveIndex(v, data.positions.size()),
+			resolveIndex(vt, data.texCoords.size()),
+			resolveIndex(vn, data.normals.size()));
+
+		if (count == 0)
+			first = corner;
+		else if (count >= 2)
+		{
+			data.corners.push_back(first);
+			data.corners.push_back(previous);
+			data.corners.push_back(corner);
+		}
+
+		previous = corner;
+		count++;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Clears all the arrays
+//-----------------------------------------------------------------------------
+void ObjData::clear()
+{
+	positions.clear();
+	texCoords.clear();
+	normals.clear();
+	corners.clear();
+	bounds = MeshBounds();
+}
+
+//-----------------------------------------------------------------------------
+// Parses the v, vt, vn and f records in [begin, end), which must start at a line,
+// keeping track of the extreme positions on the way
+//-----------------------------------------------------------------------------
+static void parseChunk(const char* begin, const char* end, ObjData& data, Extremes& extremes)
+{
+	const char* p = begin;
+	extremes.empty = true;
+
+	while (p < end)
+	{
+		const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+		if (lineEnd == NULL)
+			lineEnd = end;
+
+		p = skipSpaces(p, lineEnd);
+
+		if (lineEnd - p >= 2)
+		{
+			if (p[0] == 'v')
+			{
+				if (isSpace(p[1]))
+				{
+					glm::vec3 vertex;
+					parseFloats(p + 2, lineEnd, &vertex[0], 3);
+					data.positions.push_back(vertex);
+
+					if (extremes.empty)
+					{
+						for (int axis = 0; axis < 3; axis++)
+							extremes.minPoint[axis] = extremes.maxPoint[axis] = vertex;
+						extremes.empty = false;
+					}
+					for (int axis = 0; axis < 3; axis++)
+						addExtreme(extremes, vertex, vertex, axis);
+				}
+				else if (p[1] == 't' && lineEnd - p >= 3 && isSpace(p[2]))
+				{
+					glm::vec2 uv;
+					parseFloats(p + 3, lineEnd, &uv[0], 2);
+					data.texCoords.push_back(uv);
+				}
+				else if (p[1] == 'n' && lineEnd - p >= 3 && isSpace(p[2]))
+				{
+					glm::vec3 normal;
+					parseFloats(p + 3, lineEnd, &normal[0], 3);
+					data.normals.push_back(glm::normalize(normal));
+				}
+			}
+			else if (p[0] == 'f' && isSpace(p[1]))
+			{
+				parseFace(p + 2, lineEnd, data);
+			}
+		}
+
+		p = lineEnd + 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Copies a parsed chunk into its slot of the merged arrays
+//-----------------------------------------------------------------------------
+static void mergeChunk(const ObjData& chunk, const ChunkOffsets& first, ObjData& data)
+{
+	std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + first.positions);
+	std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), data.texCoords.begin() + first.texCoords);
+	std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + first.normals);
+
+	for (size_t i = 0; i < chunk.corners.size(); i++)
+	{
+		const glm::ivec3& corner = chunk.corners[i];
+		data.corners[first.corners + i] = glm::ivec3(fixRelativeIndex(corner.x, (int)first.positions),
+			fixRelativeIndex(corner.y, (int)first.texCoords),
+			fixRelativeIndex(corner.z, (int)first.normals));
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Parses an OBJ file held in [begin, end).
+//
+// Large files are cut at line boundaries into one chunk per thread and the
+// chunks are parsed in parallel.  A prefix sum over the per-chunk attribute
+// counts then gives every chunk its offset in the merged arrays, which is
+// all that is needed to resolve relative face indices.  The bounding volumes
+// come from the per-chunk extreme positions and one pass over the positions.
+// threadCount 0 uses every hardware thread.
+//-----------------------------------------------------------------------------
+void ObjLoader::parse(const char* begin, const char* end, ObjData& data, unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	size_t size = end - begin;
+	size_t numChunks = std::min((size_t)threadCount, std::max((size_t)1, size / MIN_CHUNK_SIZE));
+
+	data.clear();
+
+	if (numChunks == 1)
+	{
+		Extremes extremes;
+		parseChunk(begin, end, data, extremes);
+		for (size_t i = 0; i < data.corners.size(); i++)
+		{
+			glm::ivec3& corner = data.corners[i];
+			corner = glm::ivec3(fixRelativeIndex(corner.x, 0), fixRelativeIndex(corner.y, 0), fixRelativeIndex(corner.z, 0));
+		}
+		computeBounds(extremes, data.positions, data.bounds);
+		return;
+	}
+
+	// Chunk boundaries, each moved forward to the start of the next line
+	std::vector<const char*> bounds(numChunks + 1);
+	bounds[0] = begin;
+	bounds[numChunks] = end;
+	for (size_t i = 1; i < numChunks; i++)
+	{
+		const char* p = std::max(begin + size * i / numChunks, bounds[i - 1]);
+		const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+		bounds[i] = lineEnd ? lineEnd + 1 : end;
+	}
+
+	std::vector<ObjData> chunks(numChunks);
+	std::vector<Extremes> chunkExtremes(numChunks);
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < numChunks; i++)
+		workers.push_back(std::thread(parseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]), std::ref(chunkExtremes[i])));
+	parseChunk(bounds[0], bounds[1], chunks[0], chunkExtremes[0]);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+
+	// Exclusive prefix sum of the per-chunk counts
+	std::vector<ChunkOffsets> offsets(numChunks + 1);
+	offsets[0].positions = offsets[0].texCoords = offsets[0].normals = offsets[0].corners = 0;
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		offsets[i + 1].positions = offsets[i].positions + chunks[i].positions.size();
+		offsets[i + 1].texCoords = offsets[i].texCoords + chunks[i].texCoords.size();
+		offsets[i + 1].normals = offsets[i].normals + chunks[i].normals.size();
+		offsets[i + 1].corners = offsets[i].corners + chunks[i].corners.size();
+	}
+
+	data.positions.resize(offsets[numChunks].positions);
+	data.texCoords.resize(offsets[numChunks].texCoords);
+	data.normals.resize(offsets[numChunks].normals);
+	data.corners.resize(offsets[numChunks].corners);
+
+	for (size_t i = 1; i < numChunks; i++)
+		workers.push_back(std::thread(mergeChunk, std::cref(chunks[i]), std::cref(offsets[i]), std::ref(data)));
+	mergeChunk(chunks[0], offsets[0], data);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	Extremes extremes;
+	extremes.empty = true;
+	for (size_t i = 0; i < numChunks; i++)
+		addExtremes(extremes, chunkExtremes[i]);
+	computeBounds(extremes, data.positions, data.bounds);
+}
+
+//-----------------------------------------------------------------------------
+// Builds a unique vertex for every distinct (v, vt, vn) triplet used by the
+// faces and an index per face corner.  The triplets are deduplicated with an
+// open addressing hash table sized to at most half full.
+//-----------------------------------------------------------------------------
+void ObjLoader::buildIndexedVertices(const ObjData& data, std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	vertices.clear();
+	indices.resize(data.corners.size());
+
+	size_t tableSize = 16;
+	while (tableSize < data.corners.size() * 2)
+		tableSize *= 2;
+
+	// Each slot holds the corner that first used a triplet, or EMPTY
+	const GLuint EMPTY = 0xFFFFFFFF;
+	std::vector<GLuint> table(tableSize, EMPTY);
+
+	for (size_t i = 0; i < data.corners.size(); i++)
+	{
+		const glm::ivec3& corner = data.corners[i];
+
+		unsigned int h = (unsigned int)corner.x * 73856093u ^ (unsigned int)corner.y * 19349663u ^ (unsigned int)corner.z * 83492791u;
+		size_t slot = h & (tableSize - 1);
+
+		while (table[slot] != EMPTY && data.corners[table[slot]] != corner)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == EMPTY)
+		{
+			table[slot] = (GLuint)i;
+			indices[i] = (GLuint)vertices.size();
+
+			Vertex meshVertex;
+			if (corner.x >= 0 && corner.x < (int)data.positions.size())
+				meshVertex.position = data.positions[corner.x];
+
+			if (corner.y >= 0 && corner.y < (int)data.texCoords.size())
+				meshVertex.texCoords = data.texCoords[corner.y];
+
+			if (corner.z >= 0 && corner.z < (int)data.normals.size())
+				meshVertex.normal = data.normals[corner.z];
+
+			vertices.push_back(meshVertex);
+		}
+		else
+			indices[i] = indices[table[slot]];
+	}
+}
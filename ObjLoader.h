@@ -0,0 +1,40 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+
+//--------------------------------------------------------------
+// Raw contents of an OBJ file.  Face corners keep the (v, vt, vn)
+// indices already converted to 0-based; -1 marks a missing index.
+// bounds encloses every position, used by the faces or not.
+//--------------------------------------------------------------
+struct ObjData
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::ivec3> corners;
+	MeshBounds bounds;
+
+	void clear();
+};
+
+//--------------------------------------------------------------
+// OBJ Loader
+//
+// Parses the whole file from a single memory buffer by walking a
+// pointer over it, so no per-line or per-token strings are built.
+// Large files are split at line boundaries and parsed on several threads.
+//--------------------------------------------------------------
+class ObjLoader
+{
+public:
+
+	static void parse(const char* begin, const char* end, ObjData& data, unsigned int threadCount = 0);
+	static void buildIndexedVertices(const ObjData& data, std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+};
+#endif //OBJLOADER_H
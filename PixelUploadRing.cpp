@@ -0,0 +1,218 @@
+#include "PixelUploadRing.h"
+#include "Texture2D.h"
+#include <iostream>
+#include <cstring>
+
+
+// Level offsets in a slot, enough for any unpack alignment
+const size_t LEVEL_ALIGNMENT = 16;
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+PixelUploadRing::PixelUploadRing()
+	: mSlotBytes(0),
+	mPersistent(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+PixelUploadRing::~PixelUploadRing()
+{
+	destroy();
+}
+
+//-----------------------------------------------------------------------------
+// Allocates slotCount buffers of slotBytes and maps them
+//-----------------------------------------------------------------------------
+bool PixelUploadRing::create(size_t slotBytes, GLuint slotCount)
+{
+	destroy();
+
+	mSlotBytes = slotBytes;
+	mPersistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+	for (GLuint i = 0; i < slotCount; i++)
+	{
+		Slot slot = { 0, NULL, 0, SLOT_UNMAPPED };
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		if (mPersistent)
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slotBytes, NULL, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+		else
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, slotBytes, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		mSlots.push_back(slot);
+		if (slot.buffer == 0 || !map(mSlots.back()))
+		{
+			std::cerr << "Unable to create pixel upload buffers!" << std::endl;
+			destroy();
+			return false;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Releases the buffers; nothing may be stored or uploading
+//-----------------------------------------------------------------------------
+void PixelUploadRing::destroy()
+{
+	for (size_t i = 0; i < mSlots.size(); i++)
+	{
+		Slot& slot = mSlots[i];
+		if (slot.fence != 0)
+			glDeleteSync(slot.fence);
+		if (slot.memory != NULL)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glDeleteBuffers(1, &slot.buffer);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	mSlots.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Maps a slot the GPU is done with and makes it free
+//-----------------------------------------------------------------------------
+bool PixelUploadRing::map(Slot& slot)
+{
+	// The fence already passed, so the fallback mapping needs no synchronization
+	GLbitfield access = mPersistent ? (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT) :
+		(GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+	void* memory = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mSlotBytes, access);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (memory == NULL)
+		return false;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	slot.memory = (unsigned char*)memory;
+	slot.state = SLOT_FREE;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Worker thread: copies the levels into a slot.  The copy runs unlocked;
+// the slot belongs to data until release().
+//-----------------------------------------------------------------------------
+bool PixelUploadRing::store(TextureMipData& data)
+{
+	std::vector<size_t> offsets;
+	size_t bytes = 0;
+	for (size_t i = 0; i < data.levels.size(); i++)
+	{
+		offsets.push_back(bytes);
+		bytes += (data.levels[i].size() + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+	}
+	if (data.levels.empty() || bytes > mSlotBytes)
+		return false;
+
+	Slot* slot = NULL;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (size_t i = 0; i < mSlots.size() && slot == NULL; i++)
+		{
+			if (mSlots[i].state == SLOT_FREE)
+				slot = &mSlots[i];
+		}
+		if (slot == NULL)
+			return false;
+		slot->state = SLOT_STORED;
+	}
+
+	data.bufferSizes.clear();
+	for (size_t i = 0; i < data.levels.size(); i++)
+	{
+		memcpy(slot->memory + offsets[i], data.levels[i].data(), data.levels[i].size());
+		data.bufferSizes.push_back(data.levels[i].size());
+	}
+	data.pixelBuffer = slot->buffer;
+	data.bufferOffsets.swap(offsets);
+	std::vector<std::vector<unsigned char> >().swap(data.levels);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Before the uploads from a stored data: the fallback buffers can't be read
+// by GL while mapped
+//-----------------------------------------------------------------------------
+void PixelUploadRing::prepare(const TextureMipData& data)
+{
+	Slot* slot = findSlot(data.pixelBuffer);
+	if (slot == NULL || mPersistent)
+		return;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	slot->memory = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// After the uploads from a stored data: the slot is reused once the GPU
+// has read it
+//-----------------------------------------------------------------------------
+void PixelUploadRing::release(TextureMipData& data)
+{
+	Slot* slot = findSlot(data.pixelBuffer);
+	if (slot == NULL)
+		return;
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		slot->fence = fence;
+		slot->state = SLOT_IN_FLIGHT;
+	}
+
+	data.pixelBuffer = 0;
+	data.bufferOffsets.clear();
+	data.bufferSizes.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Frees the slots whose fence has passed, without waiting for the others
+//-----------------------------------------------------------------------------
+void PixelUploadRing::update()
+{
+	for (size_t i = 0; i < mSlots.size(); i++)
+	{
+		Slot& slot = mSlots[i];
+		if (slot.state == SLOT_IN_FLIGHT)
+		{
+			GLenum status = glClientWaitSync(slot.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+
+			glDeleteSync(slot.fence);
+			std::lock_guard<std::mutex> lock(mMutex);
+			slot.fence = 0;
+			slot.state = mPersistent ? SLOT_FREE : SLOT_UNMAPPED;
+		}
+
+		if (slot.state == SLOT_UNMAPPED)
+			map(slot);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Slot of a buffer name
+//-----------------------------------------------------------------------------
+PixelUploadRing::Slot* PixelUploadRing::findSlot(GLuint buffer)
+{
+	for (size_t i = 0; i < mSlots.size(); i++)
+	{
+		if (buffer != 0 && mSlots[i].buffer == buffer)
+			return &mSlots[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,81 @@
+#ifndef PIXELUPLOADRING_H
+#define PIXELUPLOADRING_H
+
+#include <vector>
+#include <mutex>
+
+#include "GL/glew.h"
+
+struct TextureMipData;
+
+//--------------------------------------------------------------
+// Pixel Upload Ring
+//
+// A ring of pixel unpack buffers that worker threads copy
+// decoded texture levels into, so the texture upload on the
+// render thread reads from GPU visible memory and returns
+// without the driver copying the pixels first.
+//
+// With GL 4.4 / ARB_buffer_storage the buffers stay mapped
+// (persistent, coherent); otherwise each one is mapped on the
+// render thread while it's free and unmapped just before the
+// upload.  A fence after the upload tells when the slot can be
+// written again.
+//
+// store() may be called from any thread, everything else from
+// the render thread.
+//--------------------------------------------------------------
+class PixelUploadRing
+{
+public:
+	PixelUploadRing();
+	~PixelUploadRing();
+
+	bool create(size_t slotBytes, GLuint slotCount);
+	void destroy();
+
+	// Copies the levels into a free slot and releases data.levels. False,
+	// leaving data as it was, if they don't fit or no slot is free.
+	bool store(TextureMipData& data);
+
+	// Around the GL calls that read a stored data: prepare makes the buffer
+	// usable as the unpack source, release fences it for reuse
+	void prepare(const TextureMipData& data);
+	void release(TextureMipData& data);
+
+	// Once per frame: recycles the slots the GPU is done with
+	void update();
+
+	bool isCreated() const { return !mSlots.empty(); }
+	bool isPersistent() const { return mPersistent; }
+	size_t getSlotBytes() const { return mSlotBytes; }
+
+private:
+	PixelUploadRing(const PixelUploadRing& rhs);
+	PixelUploadRing& operator = (const PixelUploadRing& rhs);
+
+	enum SlotState
+	{
+		SLOT_FREE,			// mapped and waiting for store()
+		SLOT_STORED,		// holds levels not uploaded yet
+		SLOT_IN_FLIGHT,		// uploads issued, waiting for the fence
+		SLOT_UNMAPPED		// fallback: done, to be mapped again
+	};
+
+	struct Slot
+	{
+		GLuint buffer;
+		unsigned char* memory;
+		GLsync fence;
+		SlotState state;
+	};
+
+	Slot* findSlot(GLuint buffer);
+	bool map(Slot& slot);
+
+	std::vector<Slot> mSlots;
+	size_t mSlotBytes;
+	bool mPersistent;
+	std::mutex mMutex;
+};
+#endif //PIXELUPLOADRING_H
@@ -0,0 +1,113 @@
+#include "RenderQueue.h"
+
+
+static const unsigned long long PROGRAM_BITS = 6;
+static const unsigned long long TEXTURE_BITS = 10;
+static const unsigned long long MATERIAL_BITS = 8;
+static const unsigned long long DEPTH_BITS = 24;
+static const unsigned long long MESH_BITS = 14;
+
+static inline unsigned long long field(GLuint value, unsigned long long bits)
+{
+	return (unsigned long long)value & ((1ULL << bits) - 1);
+}
+
+//-----------------------------------------------------------------------------
+// Quantizes a depth in [0, 1] (e.g. view distance / far plane)
+//-----------------------------------------------------------------------------
+static inline unsigned long long quantizeDepth(float depth)
+{
+	if (!(depth > 0.0f))
+		return 0;
+	if (depth >= 1.0f)
+		return (1ULL << DEPTH_BITS) - 1;
+	return (unsigned long long)(depth * (float)((1ULL << DEPTH_BITS) - 1));
+}
+
+//-----------------------------------------------------------------------------
+// Key of an opaque draw: grouped by state, then front to back
+//-----------------------------------------------------------------------------
+unsigned long long RenderQueue::makeOpaqueKey(GLuint program, GLuint texture, GLuint material, GLuint mesh, float depth)
+{
+	unsigned long long key = RENDER_PASS_OPAQUE;
+	key = (key << PROGRAM_BITS) | field(program, PROGRAM_BITS);
+	key = (key << TEXTURE_BITS) | field(texture, TEXTURE_BITS);
+	key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+	key = (key << DEPTH_BITS) | quantizeDepth(depth);
+	key = (key << MESH_BITS) | field(mesh, MESH_BITS);
+	return key;
+}
+
+//-----------------------------------------------------------------------------
+// Key of a transparent draw: back to front first, state only breaks ties
+//-----------------------------------------------------------------------------
+unsigned long long RenderQueue::makeTransparentKey(GLuint program, GLuint texture, GLuint material, GLuint mesh, float depth)
+{
+	unsigned long long key = RENDER_PASS_TRANSPARENT;
+	key = (key << DEPTH_BITS) | (((1ULL << DEPTH_BITS) - 1) - quantizeDepth(depth));
+	key = (key << PROGRAM_BITS) | field(program, PROGRAM_BITS);
+	key = (key << TEXTURE_BITS) | field(texture, TEXTURE_BITS);
+	key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+	key = (key << MESH_BITS) | field(mesh, MESH_BITS);
+	return key;
+}
+
+//-----------------------------------------------------------------------------
+// Adds a draw to the queue
+//-----------------------------------------------------------------------------
+void RenderQueue::submit(unsigned long long key, GLuint index)
+{
+	RenderItem item = { key, index };
+	mItems.push_back(item);
+}
+
+//-----------------------------------------------------------------------------
+// Sorts the queue by key with an LSD radix sort, one byte per pass.  The
+// histograms of all eight bytes come from a single read of the keys, and
+// bytes that are the same in every key (unused programs, a single pass...)
+// skip their pass.  Stable, so equal keys keep their submission order.
+//-----------------------------------------------------------------------------
+void RenderQueue::sort()
+{
+	size_t count = mItems.size();
+	if (count < 2)
+		return;
+
+	size_t histogram[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned long long key = mItems[i].key;
+		for (int byte = 0; byte < 8; byte++)
+			histogram[byte][(key >> (byte * 8)) & 0xFF]++;
+	}
+
+	mScratch.resize(count);
+	RenderItem* source = &mItems[0];
+	RenderItem* destination = &mScratch[0];
+
+	for (int byte = 0; byte < 8; byte++)
+	{
+		size_t* counts = histogram[byte];
+		if (counts[(source[0].key >> (byte * 8)) & 0xFF] == count)
+			continue;
+
+		// Exclusive prefix sum gives each bucket's first slot
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			size_t bucketCount = counts[bucket];
+			counts[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			destination[counts[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+
+		RenderItem* swap = source;
+		source = destination;
+		destination = swap;
+	}
+
+	if (source != &mItems[0])
+		mItems.swap(mScratch);
+}
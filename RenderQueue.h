@@ -0,0 +1,52 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+
+#include "GL/glew.h"
+
+
+// Render passes, drawn in this order
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_TRANSPARENT
+};
+
+// A submitted draw: its sort key and the caller's index of what to draw
+struct RenderItem
+{
+	unsigned long long key;
+	GLuint index;
+};
+
+//--------------------------------------------------------------
+// Render Queue
+//
+// Draws are submitted as 64 bit sort keys and radix sorted before
+// they are executed, so draws sharing state end up next to each
+// other.  Opaque keys, most significant first:
+//   pass (2) | program (6) | texture (10) | material (8) | depth (24) | mesh (14)
+// so state changes are grouped and, within one state, geometry goes
+// front to back for early-Z.  Transparent keys put the inverted
+// depth right after the pass so they are drawn back to front.
+//--------------------------------------------------------------
+class RenderQueue
+{
+public:
+
+	static unsigned long long makeOpaqueKey(GLuint program, GLuint texture, GLuint material, GLuint mesh, float depth);
+	static unsigned long long makeTransparentKey(GLuint program, GLuint texture, GLuint material, GLuint mesh, float depth);
+
+	void clear() { mItems.clear(); }
+	void submit(unsigned long long key, GLuint index);
+	void sort();
+
+	size_t size() const { return mItems.size(); }
+	const RenderItem& operator [] (size_t i) const { return mItems[i]; }
+
+private:
+	std::vector<RenderItem> mItems;
+	std::vector<RenderItem> mScratch;
+};
+#endif //RENDERQUEUE_H
@@ -0,0 +1,236 @@
+#include "ResourceManager.h"
+#include "AssetLoader.h"
+#include "TextureStreamer.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
+#include <climits>
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+ResourceManager::ResourceManager()
+{
+	mStats.requests = 0;
+	mStats.pathHits = 0;
+	mStats.contentHits = 0;
+	mStats.loads = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the mesh of a file, loading it the first time it's asked for
+// with these settings
+//-----------------------------------------------------------------------------
+MeshHandle ResourceManager::getMesh(const std::string& filename, const MeshSettings& settings, AssetLoader* loader)
+{
+	std::ostringstream suffix;
+	suffix << "|" << settings.format << "|" << settings.lodCount << "|" << settings.arena << "|" << settings.optimize;
+
+	std::string pathKey, contentKey;
+	MeshHandle mesh = find(mMeshes, filename, suffix.str(), loader == NULL, pathKey, contentKey);
+	if (mesh)
+		return mesh;
+
+	mesh = std::make_shared<Mesh>();
+	mesh->setVertexFormat(settings.format);
+	mesh->setLODCount(settings.lodCount);
+	if (settings.arena != NULL)
+		mesh->setArena(settings.arena);
+	insert(mMeshes, mesh, pathKey, contentKey);
+
+	if (loader != NULL)
+		loader->loadMesh(mesh.get(), filename, settings.optimize);
+	else
+		mesh->loadOBJ(filename, settings.optimize);
+	return mesh;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the texture of a file, loading it the first time it's asked for
+//-----------------------------------------------------------------------------
+TextureHandle ResourceManager::getTexture(const std::string& filename, bool generateMipMaps, AssetLoader* loader)
+{
+	std::string pathKey, contentKey;
+	TextureHandle texture = find(mTextures, filename, generateMipMaps ? "|1" : "|0", loader == NULL, pathKey, contentKey);
+	if (texture)
+		return texture;
+
+	texture = std::make_shared<Texture2D>();
+	insert(mTextures, texture, pathKey, contentKey);
+
+	if (loader != NULL)
+		loader->loadTexture(texture.get(), filename, generateMipMaps);
+	else
+		texture->loadTexture(filename, generateMipMaps);
+	return texture;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the streamed texture of a file, handing it to the streamer the
+// first time it's asked for
+//-----------------------------------------------------------------------------
+TextureHandle ResourceManager::getStreamedTexture(const std::string& filename, TextureStreamer& streamer)
+{
+	std::string pathKey, contentKey;
+	TextureHandle texture = find(mTextures, filename, "|stream", false, pathKey, contentKey);
+	if (texture)
+		return texture;
+
+	texture = std::make_shared<Texture2D>();
+	insert(mTextures, texture, pathKey, contentKey);
+	streamer.add(texture, filename);
+	return texture;
+}
+
+//-----------------------------------------------------------------------------
+// Looks a file up by path, then (if hashContents) by contents.  On a miss,
+// pathKey and contentKey are what to insert the new resource under; a
+// content hit is remembered under the new path so the file isn't hashed
+// again.  A failed resource found either way is released, so it loads again.
+//-----------------------------------------------------------------------------
+template <typename T>
+std::shared_ptr<T> ResourceManager::find(Table<T>& table, const std::string& filename, const std::string& settings,
+	bool hashContents, std::string& pathKey, std::string& contentKey)
+{
+	mStats.requests++;
+
+	pathKey = getCanonicalPath(filename) + settings;
+	typename std::map<std::string, std::string>::iterator path = table.paths.find(pathKey);
+	if (path != table.paths.end())
+	{
+		std::shared_ptr<T> resource = table.resources[path->second];
+		if (!resource->hasFailed())
+		{
+			mStats.pathHits++;
+			return resource;
+		}
+		release(table, std::string(path->second));
+	}
+
+	contentKey.clear();
+	if (hashContents)
+		contentKey = getContentKey(filename);
+	if (!contentKey.empty())
+	{
+		contentKey += settings;
+		typename std::map<std::string, std::string>::iterator content = table.contents.find(contentKey);
+		if (content != table.contents.end())
+		{
+			std::shared_ptr<T> resource = table.resources[content->second];
+			if (!resource->hasFailed())
+			{
+				mStats.contentHits++;
+				table.paths[pathKey] = content->second;
+				return resource;
+			}
+			release(table, std::string(content->second));
+		}
+	}
+
+	mStats.loads++;
+	return std::shared_ptr<T>();
+}
+
+//-----------------------------------------------------------------------------
+// Adds a resource that find() missed
+//-----------------------------------------------------------------------------
+template <typename T>
+void ResourceManager::insert(Table<T>& table, const std::shared_ptr<T>& resource, const std::string& pathKey, const std::string& contentKey)
+{
+	table.resources[pathKey] = resource;
+	table.paths[pathKey] = pathKey;
+	if (!contentKey.empty())
+		table.contents[contentKey] = pathKey;
+}
+
+//-----------------------------------------------------------------------------
+// Drops the manager's reference to a resource, along with the paths and
+// contents that lead to it
+//-----------------------------------------------------------------------------
+template <typename T>
+void ResourceManager::release(Table<T>& table, const std::string& key)
+{
+	for (std::map<std::string, std::string>::iterator path = table.paths.begin(); path != table.paths.end();)
+	{
+		if (path->second == key)
+			path = table.paths.erase(path);
+		else
+			++path;
+	}
+	for (std::map<std::string, std::string>::iterator content = table.contents.begin(); content != table.contents.end();)
+	{
+		if (content->second == key)
+			content = table.contents.erase(content);
+		else
+			++content;
+	}
+	table.resources.erase(key);
+}
+
+//-----------------------------------------------------------------------------
+// Releases the loaded or failed resources of a table only the manager
+// refers to
+//-----------------------------------------------------------------------------
+template <typename T>
+size_t ResourceManager::purge(Table<T>& table)
+{
+	std::vector<std::string> keys;
+	typename std::map<std::string, std::shared_ptr<T> >::iterator it;
+	for (it = table.resources.begin(); it != table.resources.end(); ++it)
+	{
+		if (it->second.use_count() == 1 && (it->second->isLoaded() || it->second->hasFailed()))
+			keys.push_back(it->first);
+	}
+
+	for (size_t i = 0; i < keys.size(); i++)
+		release(table, keys[i]);
+	return keys.size();
+}
+
+//-----------------------------------------------------------------------------
+// Releases meshes and textures nobody else holds.  Call from the GL thread,
+// since releasing deletes their GL objects.
+//-----------------------------------------------------------------------------
+size_t ResourceManager::purge()
+{
+	return purge(mMeshes) + purge(mTextures);
+}
+
+//-----------------------------------------------------------------------------
+// Resolves a path to one spelling per file
+//-----------------------------------------------------------------------------
+std::string ResourceManager::getCanonicalPath(const std::string& filename)
+{
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (_fullpath(buffer, filename.c_str(), _MAX_PATH) == NULL)
+		return filename;
+
+	std::string path = buffer;
+	for (size_t i = 0; i < path.size(); i++)
+		path[i] = (path[i] == '/') ? '\\' : (char)tolower((unsigned char)path[i]);
+	return path;
+#else
+	char buffer[PATH_MAX];
+	if (realpath(filename.c_str(), buffer) == NULL)
+		return filename;
+	return buffer;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Content key: 64 bit FNV-1a of the file (as the mesh cache uses) and its size
+//-----------------------------------------------------------------------------
+std::string ResourceManager::getContentKey(const std::string& filename)
+{
+	MappedFile file;
+	if (!file.open(filename))
+		return std::string();
+
+	std::ostringstream key;
+	key << std::hex << MeshCache::hash(file.data(), file.size()) << ":" << std::dec << file.size();
+	return key.str();
+}
@@ -0,0 +1,114 @@
+#ifndef RESOURCEMANAGER_H
+#define RESOURCEMANAGER_H
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "Mesh.h"
+#include "Texture2D.h"
+
+class AssetLoader;
+class TextureStreamer;
+
+typedef std::shared_ptr<Mesh> MeshHandle;
+typedef std::shared_ptr<Texture2D> TextureHandle;
+
+// How a mesh is loaded; meshes are only shared between identical settings
+struct MeshSettings
+{
+	VertexFormat format;
+	GLuint lodCount;
+	MeshArena* arena;
+	bool optimize;
+
+	MeshSettings(VertexFormat format = VERTEX_FORMAT_FLOAT, GLuint lodCount = 1, MeshArena* arena = NULL, bool optimize = false)
+		: format(format), lodCount(lodCount), arena(arena), optimize(optimize) {}
+};
+
+//--------------------------------------------------------------
+// Resource Manager
+//
+// Hands out shared handles to meshes and textures so that every
+// reference to the same file shares one GPU upload.  Resources
+// are looked up by canonical path first; on a synchronous load
+// a path seen for the first time is hashed, and a file whose
+// contents match one already loaded (a copy under another name)
+// is shared as well.
+//
+// Loading goes through an AssetLoader when one is given (the
+// handle is returned at once, isLoaded() tells when it's ready),
+// otherwise it happens before the call returns.  Asynchronous
+// and streamed requests are keyed by path only, so the render
+// thread never reads a whole file to hash it.  A resource that
+// failed to load (hasFailed()) is dropped and loaded again the
+// next time it's asked for.  The manager keeps its own
+// reference; purge() releases resources nobody else holds.
+// With a loader, the manager must be declared before it, as the
+// loader needs the resources to outlive it.
+//--------------------------------------------------------------
+class ResourceManager
+{
+public:
+
+	struct Stats
+	{
+		size_t requests;
+		size_t pathHits;		// same file requested again
+		size_t contentHits;		// different file, same contents
+		size_t loads;
+	};
+
+	ResourceManager();
+
+	MeshHandle getMesh(const std::string& filename, const MeshSettings& settings = MeshSettings(), AssetLoader* loader = NULL);
+	TextureHandle getTexture(const std::string& filename, bool generateMipMaps = true, AssetLoader* loader = NULL);
+
+	// A texture whose mip levels the streamer loads and evicts as needed; not
+	// shared with getTexture, which loads every level
+	TextureHandle getStreamedTexture(const std::string& filename, TextureStreamer& streamer);
+
+	// Releases loaded or failed resources held only by the manager; returns
+	// how many.  Pending ones stay, as a loader may still be working on them.
+	size_t purge();
+
+	size_t getMeshCount() const { return mMeshes.resources.size(); }
+	size_t getTextureCount() const { return mTextures.resources.size(); }
+	const Stats& getStats() const { return mStats; }
+
+	// Absolute path with . and .. resolved (and case folded on Windows);
+	// the path as given if the file doesn't exist
+	static std::string getCanonicalPath(const std::string& filename);
+
+private:
+	ResourceManager(const ResourceManager& rhs);
+	ResourceManager& operator = (const ResourceManager& rhs);
+
+	// Resources of one type.  Every path or content that leads to a
+	// resource maps to the key it was first loaded under.
+	template <typename T>
+	struct Table
+	{
+		std::map<std::string, std::shared_ptr<T> > resources;	// by first path key
+		std::map<std::string, std::string> paths;				// canonical path + settings
+		std::map<std::string, std::string> contents;			// content key + settings
+	};
+
+	template <typename T>
+	std::shared_ptr<T> find(Table<T>& table, const std::string& filename, const std::string& settings,
+		bool hashContents, std::string& pathKey, std::string& contentKey);
+	template <typename T>
+	void insert(Table<T>& table, const std::shared_ptr<T>& resource, const std::string& pathKey, const std::string& contentKey);
+	template <typename T>
+	void release(Table<T>& table, const std::string& key);
+	template <typename T>
+	size_t purge(Table<T>& table);
+
+	// Hash and size of a file's contents; empty if it can't be read
+	static std::string getContentKey(const std::string& filename);
+
+	Table<Mesh> mMeshes;
+	Table<Texture2D> mTextures;
+	Stats mStats;
+};
+#endif //RESOURCEMANAGER_H
@@ -1,4 +1,5 @@
 #include "ShaderProgram.h"
+#include "GLState.h"
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -19,7 +20,7 @@ ShaderProgram::ShaderProgram()
 ShaderProgram::~ShaderProgram()
 {
 	// Delete the program
-	glDeleteProgram(mHandle);
+	GLState::deleteProgram(mHandle);
 }
 
 //-----------------------------------------------------------------------------
@@ -61,7 +62,7 @@ bool ShaderProgram::loadShaders(const char* vsFilename, const char* fsFilename)
 	glDeleteShader(vs);
 	glDeleteShader(fs);
 
-	mUniformLocations.clear();
+	reflectUniforms();
 
 	return true;
 }
@@ -103,7 +104,7 @@ string ShaderProgram::fileToString(const string& filename)
 void ShaderProgram::use()
 {
 	if (mHandle > 0)
-		glUseProgram(mHandle);
+		GLState::useProgram(mHandle);
 }
 
 //-----------------------------------------------------------------------------
@@ -216,27 +217,139 @@ void ShaderProgram::setUniform(const GLchar* name, const GLint v)
 //-----------------------------------------------------------------------------
 void ShaderProgram::setUniformSampler(const GLchar* name, const GLint& slot)
 {
-	glActiveTexture(GL_TEXTURE0 + slot);
+	GLState::activeTexture(slot);
 
 	GLint loc = getUniformLocation(name);
 	glUniform1i(loc, slot);
 }
 
 //-----------------------------------------------------------------------------
-// Returns the uniform identifier given it's string name.
-// NOTE: Shader must be currently active first.
+// Fills the uniform map with every active uniform of the linked program.
+// Arrays are reported as "name[0]"; they are also stored as "name".
 //-----------------------------------------------------------------------------
-GLint ShaderProgram::getUniformLocation(const GLchar* name)
+void ShaderProgram::reflectUniforms()
 {
-	std::map<string, GLint>::iterator it = mUniformLocations.find(name);
+	mUniforms.clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(mHandle, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(mHandle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	string name(maxLength, ' ');
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(mHandle, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+
+		string uniformName(name, 0, length);
+		UniformInfo info = { glGetUniformLocation(mHandle, uniformName.c_str()), type };
+
+		// Uniforms in uniform blocks have no location
+		if (info.location < 0)
+			continue;
+
+		mUniforms[uniformName] = info;
+		if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+			mUniforms[uniformName.substr(0, uniformName.size() - 3)] = info;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Looks a uniform up by name with a single map search.  Names not found by
+// reflection (e.g. array elements other than [0]) are queried once and cached.
+//-----------------------------------------------------------------------------
+const ShaderProgram::UniformInfo& ShaderProgram::findUniform(const GLchar* name)
+{
+	std::map<string, UniformInfo>::iterator it = mUniforms.lower_bound(name);
 
 	// Only need to query the shader program IF it doesn't already exist.
-	if (it == mUniformLocations.end())
+	if (it == mUniforms.end() || it->first != name)
 	{
-		// Find it and add it to the map
-		mUniformLocations[name] = glGetUniformLocation(mHandle, name);
+		UniformInfo info = { glGetUniformLocation(mHandle, name), 0 };
+		it = mUniforms.insert(it, std::make_pair(string(name), info));
 	}
 
-	// Return it
-	return mUniformLocations[name];
+	return it->second;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the uniform identifier given it's string name.
+// NOTE: Shader must be currently active first.
+//-----------------------------------------------------------------------------
+GLint ShaderProgram::getUniformLocation(const GLchar* name)
+{
+	return findUniform(name).location;
+}
+
+//-----------------------------------------------------------------------------
+// Connects the named uniform block to a binding point.  Returns false if the
+// program has no such (active) block.
+//-----------------------------------------------------------------------------
+bool ShaderProgram::bindUniformBlock(const GLchar* blockName, GLuint binding)
+{
+	GLuint index = glGetUniformBlockIndex(mHandle, blockName);
+	if (index == GL_INVALID_INDEX)
+		return false;
+
+	glUniformBlockBinding(mHandle, index, binding);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Sets a glm::vec2 shader uniform through a handle
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniform(UniformHandle<glm::vec2> handle, const glm::vec2& v)
+{
+	glUniform2f(handle.location, v.x, v.y);
+}
+
+//-----------------------------------------------------------------------------
+// Sets a glm::vec3 shader uniform through a handle
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniform(UniformHandle<glm::vec3> handle, const glm::vec3& v)
+{
+	glUniform3f(handle.location, v.x, v.y, v.z);
+}
+
+//-----------------------------------------------------------------------------
+// Sets a glm::vec4 shader uniform through a handle
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniform(UniformHandle<glm::vec4> handle, const glm::vec4& v)
+{
+	glUniform4f(handle.location, v.x, v.y, v.z, v.w);
+}
+
+//-----------------------------------------------------------------------------
+// Sets a glm::mat4 shader uniform through a handle
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniform(UniformHandle<glm::mat4> handle, const glm::mat4& m)
+{
+	glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(m));
+}
+
+//-----------------------------------------------------------------------------
+// Sets a GLfloat shader uniform through a handle
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniform(UniformHandle<GLfloat> handle, const GLfloat f)
+{
+	glUniform1f(handle.location, f);
+}
+
+//-----------------------------------------------------------------------------
+// Sets a GLint shader uniform through a handle
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniform(UniformHandle<GLint> handle, const GLint v)
+{
+	glUniform1i(handle.location, v);
+}
+
+//-----------------------------------------------------------------------------
+// Sets a sampler uniform through a handle and activates its texture unit
+//-----------------------------------------------------------------------------
+void ShaderProgram::setUniformSampler(UniformHandle<GLint> handle, const GLint& slot)
+{
+	GLState::activeTexture(slot);
+	glUniform1i(handle.location, slot);
 }
\ No newline at end of file
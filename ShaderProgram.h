@@ -3,11 +3,46 @@
 
 #include <string>
 #include <map>
+#include <iostream>
 #include "GL/glew.h"
 #include "glm/glm.hpp"
 using std::string;
 
 
+//--------------------------------------------------------------
+// Location of a uniform resolved once, typed by the value set
+// through it.  Default constructed handles are invalid (-1) and
+// setting them is a no-op, like a missing uniform name.
+//--------------------------------------------------------------
+template <typename T>
+struct UniformHandle
+{
+	GLint location;
+
+	UniformHandle() : location(-1) {}
+	explicit UniformHandle(GLint loc) : location(loc) {}
+
+	bool isValid() const { return location >= 0; }
+};
+
+// Which GLSL uniform types a handle of type T can set
+template <typename T> struct UniformTraits;
+template <> struct UniformTraits<glm::vec2> { static bool accepts(GLenum type) { return type == GL_FLOAT_VEC2; } };
+template <> struct UniformTraits<glm::vec3> { static bool accepts(GLenum type) { return type == GL_FLOAT_VEC3; } };
+template <> struct UniformTraits<glm::vec4> { static bool accepts(GLenum type) { return type == GL_FLOAT_VEC4; } };
+template <> struct UniformTraits<glm::mat4> { static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; } };
+template <> struct UniformTraits<GLfloat> { static bool accepts(GLenum type) { return type == GL_FLOAT; } };
+template <> struct UniformTraits<GLint>
+{
+	// ints, bools and samplers are all set with glUniform1i
+	static bool accepts(GLenum type)
+	{
+		return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_2D_ARRAY ||
+			type == GL_SAMPLER_CUBE || type == GL_SAMPLER_BUFFER || type == GL_INT_SAMPLER_BUFFER || type == GL_UNSIGNED_INT_SAMPLER_BUFFER;
+	}
+};
+
+
 class ShaderProgram
 {
 public:
@@ -35,16 +70,59 @@ public:
 	void setUniform(const GLchar* name, const GLint v);
 	void setUniformSampler(const GLchar* name, const GLint& slot);
 
+	// Connects a uniform block of the program to a buffer binding point
+	bool bindUniformBlock(const GLchar* blockName, GLuint binding);
+
+	// Resolve a handle once after loadShaders and set it every frame without any lookup
+	template <typename T>
+	UniformHandle<T> getUniformHandle(const GLchar* name);
+
+	void setUniform(UniformHandle<glm::vec2> handle, const glm::vec2& v);
+	void setUniform(UniformHandle<glm::vec3> handle, const glm::vec3& v);
+	void setUniform(UniformHandle<glm::vec4> handle, const glm::vec4& v);
+	void setUniform(UniformHandle<glm::mat4> handle, const glm::mat4& m);
+	void setUniform(UniformHandle<GLfloat> handle, const GLfloat f);
+	void setUniform(UniformHandle<GLint> handle, const GLint v);
+	void setUniformSampler(UniformHandle<GLint> handle, const GLint& slot);
+
 	// We are going to speed up looking for uniforms by keeping their locations in a map
 	GLint getUniformLocation(const GLchar * name);
 
 private:
 
+	struct UniformInfo
+	{
+		GLint location;
+		GLenum type;
+	};
+
 	string fileToString(const string& filename);
 	void  checkCompileErrors(GLuint shader, ShaderType type);
+	void reflectUniforms();
+	const UniformInfo& findUniform(const GLchar* name);
 
 
 	GLuint mHandle;
-	std::map<string, GLint> mUniformLocations;
+	std::map<string, UniformInfo> mUniforms;
 };
+
+//-----------------------------------------------------------------------------
+// Returns a handle to a uniform, warning when it is missing or its GLSL type
+// can't be set with T
+//-----------------------------------------------------------------------------
+template <typename T>
+UniformHandle<T> ShaderProgram::getUniformHandle(const GLchar* name)
+{
+	const UniformInfo& info = findUniform(name);
+	if (info.location < 0)
+	{
+		std::cerr << "Warning! Uniform " << name << " not found or not active." << std::endl;
+		return UniformHandle<T>();
+	}
+
+	if (!UniformTraits<T>::accepts(info.type))
+		std::cerr << "Warning! Uniform " << name << " has a different type than its handle." << std::endl;
+
+	return UniformHandle<T>(info.location);
+}
 #endif // SHADER_H
\ No newline at end of file
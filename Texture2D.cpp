@@ -1,6 +1,15 @@
 #include "Texture2D.h"
+#include "GLState.h"
+#include "MappedFile.h"
 #include <iostream>
 #include <cassert>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+// Sem a mensagem de erro global do stb_image, que no  segura entre threads
+#define STBI_NO_FAILURE_STRINGS
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image/stb_image.h"
 
@@ -8,7 +17,15 @@
 // Constructor
 //-----------------------------------------------------------------------------
 Texture2D::Texture2D()
-	: mTexture(0)
+	: mTexture(0),
+	mFailed(false),
+	mImageData(NULL),
+	mWidth(0),
+	mHeight(0),
+	mStreamFormat(0),
+	mLevelCount(0),
+	mBaseLevel(0),
+	mCompressedFile(NULL)
 {
 }
 
@@ -17,7 +34,9 @@ Texture2D::Texture2D()
 //-----------------------------------------------------------------------------
 Texture2D::~Texture2D()
 {
-	glDeleteTextures(1, &mTexture);
+	GLState::deleteTexture(mTexture);
+	stbi_image_free(mImageData);
+	delete mCompressedFile;
 }
 
 //-----------------------------------------------------------------------------
@@ -26,6 +45,69 @@ Texture2D::~Texture2D()
 //-----------------------------------------------------------------------------
 bool Texture2D::loadTexture(const string& fileName, bool generateMipMaps)
 {
+	if (!decode(fileName))
+	{
+		mFailed = true;
+		return false;
+	}
+	return upload(generateMipMaps);
+}
+
+//-----------------------------------------------------------------------------
+// Carrega vrias texturas: as imagens so decodificadas em paralelo (uma
+// thread por ncleo, cada uma pegando o prximo arquivo) e enviadas ao OpenGL
+// na thread que chamou. Retorna quantas carregaram.
+//-----------------------------------------------------------------------------
+size_t Texture2D::loadTextures(const std::vector<Texture2D*>& textures, const std::vector<string>& fileNames, bool generateMipMaps)
+{
+	size_t count = std::min(textures.size(), fileNames.size());
+	size_t threadCount = std::min((size_t)std::max(1u, std::thread::hardware_concurrency()), count);
+
+	std::vector<char> decoded(count, 0);
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threadCount; t++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+				decoded[i] = textures[i]->decode(fileNames[i]);
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+
+	size_t loaded = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (decoded[i] && textures[i]->upload(generateMipMaps))
+			loaded++;
+	}
+	return loaded;
+}
+
+//-----------------------------------------------------------------------------
+// Parte da carga que no usa OpenGL: decodifica e inverte a imagem, que fica
+// guardada at upload(). Pode rodar numa thread de trabalho.
+//-----------------------------------------------------------------------------
+bool Texture2D::decode(const string& fileName)
+{
+	// KTX/DDS j comprimidos: s l o cabealho; os nveis vo do arquivo mapeado para a GPU
+	if (TextureContainer::isContainer(fileName))
+	{
+		MappedFile* file = new MappedFile();
+		if (!file->open(fileName) || !TextureContainer::parse(fileName, file->data(), file->size(), mCompressed))
+		{
+			std::cerr << "Error loading texture '" << fileName << "'" << std::endl;
+			delete file;
+			return false;
+		}
+
+		delete mCompressedFile;
+		mCompressedFile = file;
+		return true;
+	}
+
 	int width, height, components;
 
 	// Usa stbi image library para carregar nossa imagem
@@ -37,28 +119,64 @@ bool Texture2D::loadTexture(const string& fileName, bool generateMipMaps)
 		return false;
 	}
 
-	// Inverte imagem
-	int widthInBytes = width * 4;
-	unsigned char *top = NULL;
-	unsigned char *bottom = NULL;
-	unsigned char temp = 0;
+	// Inverte imagem trocando linhas inteiras com memcpy (o stbi_set_flip_vertically_on_load
+	// desta verso do stb_image  global, no serve com vrias threads decodificando)
+	size_t widthInBytes = (size_t)width * 4;
+	std::vector<unsigned char> temp(widthInBytes);
 	int halfHeight = height / 2;
 	for (int row = 0; row < halfHeight; row++)
 	{
-		top = imageData + row * widthInBytes;
-		bottom = imageData + (height - row - 1) * widthInBytes;
-		for (int col = 0; col < widthInBytes; col++)
-		{ 
-			temp = *top;
-			*top = *bottom;
-			*bottom = temp;
-			top++;
-			bottom++;
-		}
+		unsigned char* top = imageData + row * widthInBytes;
+		unsigned char* bottom = imageData + (height - row - 1) * widthInBytes;
+		memcpy(temp.data(), top, widthInBytes);
+		memcpy(top, bottom, widthInBytes);
+		memcpy(bottom, temp.data(), widthInBytes);
 	}
 
+	stbi_image_free(mImageData);
+	mImageData = imageData;
+	mWidth = width;
+	mHeight = height;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Tamanho de uma imagem lido do cabealho, sem decodific-la
+//-----------------------------------------------------------------------------
+bool Texture2D::readSize(const string& fileName, int& width, int& height)
+{
+	if (TextureContainer::isContainer(fileName))
+	{
+		MappedFile file;
+		CompressedImage image;
+		if (!file.open(fileName) || !TextureContainer::parse(fileName, file.data(), file.size(), image))
+			return false;
+
+		width = image.width;
+		height = image.height;
+		return true;
+	}
+
+	int components;
+	return stbi_info(fileName.c_str(), &width, &height, &components) != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Cria a textura com a imagem decodificada por decode() e libera a imagem.
+// Precisa do contexto OpenGL, ou seja, roda na thread de renderizao.
+//-----------------------------------------------------------------------------
+bool Texture2D::upload(bool generateMipMaps)
+{
+	if (mCompressedFile != NULL)
+		return uploadCompressed();
+
+	// Nada decodificado: o arquivo no carregou
+	mFailed = (mImageData == NULL);
+	if (mFailed)
+		return false;
+
 	glGenTextures(1, &mTexture);
-	glBindTexture(GL_TEXTURE_2D, mTexture); // todas as prximas operaes GL_TEXTURE_2D afetaro nosso objeto de textura (mTexture)
+	GLState::bindTexture(GL_TEXTURE_2D, 0, mTexture); // todas as prximas operaes GL_TEXTURE_2D afetaro nosso objeto de textura (mTexture)
 
 	// Defina as opes de envolvimento / filtragem de textura (no objeto de textura atualmente vinculado)
 	// GL_CLAMP_TO_EDGE
@@ -69,16 +187,17 @@ bool Texture2D::loadTexture(const string& fileName, bool generateMipMaps)
 	// GL_NEAREST
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generateMipMaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mWidth, mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, mImageData);
 
 	if (generateMipMaps)
 		glGenerateMipmap(GL_TEXTURE_2D);
 
-	stbi_image_free(imageData);
-	glBindTexture(GL_TEXTURE_2D, 0); 
+	stbi_image_free(mImageData);
+	mImageData = NULL;
+	GLState::bindTexture(GL_TEXTURE_2D, 0, 0);
 
 	return true;
 }
@@ -90,8 +209,7 @@ void Texture2D::bind(GLuint texUnit)
 {
 	assert(texUnit >= 0 && texUnit < 32);
 
-	glActiveTexture(GL_TEXTURE0 + texUnit);
-	glBindTexture(GL_TEXTURE_2D, mTexture);
+	GLState::bindTexture(GL_TEXTURE_2D, texUnit, mTexture);
 }
 
 //-----------------------------------------------------------------------------
@@ -99,6 +217,251 @@ void Texture2D::bind(GLuint texUnit)
 //-----------------------------------------------------------------------------
 void Texture2D::unbind(GLuint texUnit)
 {
-	glActiveTexture(GL_TEXTURE0 + texUnit);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(GL_TEXTURE_2D, texUnit, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Envia os nveis de um KTX/DDS como esto no arquivo, com
+// glCompressedTexImage2D; os mipmaps j vm prontos, nada  gerado aqui
+//-----------------------------------------------------------------------------
+bool Texture2D::uploadCompressed()
+{
+	bool uploaded = TextureContainer::isSupported(mCompressed.internalFormat);
+	if (!uploaded)
+		std::cerr << "Compressed texture format 0x" << std::hex << mCompressed.internalFormat << std::dec << " not supported" << std::endl;
+	else
+	{
+		GLsizei levelCount = (GLsizei)mCompressed.levels.size();
+
+		glGenTextures(1, &mTexture);
+		GLState::bindTexture(GL_TEXTURE_2D, 0, mTexture);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+		for (GLsizei level = 0; level < levelCount; level++)
+		{
+			const CompressedLevel& mip = mCompressed.levels[level];
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, mCompressed.internalFormat, mip.width, mip.height, 0,
+				(GLsizei)mip.size, mCompressedFile->data() + mip.offset);
+		}
+
+		GLState::bindTexture(GL_TEXTURE_2D, 0, 0);
+		mWidth = mCompressed.width;
+		mHeight = mCompressed.height;
+	}
+
+	delete mCompressedFile;
+	mCompressedFile = NULL;
+	mCompressed.levels.clear();
+	mFailed = !uploaded;
+	return uploaded;
+}
+
+//-----------------------------------------------------------------------------
+// L um trecho da cadeia de mipmaps sem chamar o OpenGL (roda numa thread de
+// trabalho). KTX/DDS: copia os nveis do arquivo. Outras imagens: decodifica a
+// imagem inteira e reduz 2x2 nvel a nvel, como o glGenerateMipmap.
+//-----------------------------------------------------------------------------
+bool Texture2D::readLevels(const string& fileName, GLsizei maxSize, GLint lastLevel, TextureMipData& data)
+{
+	data.levels.clear();
+	data.pixelBuffer = 0;
+	data.bufferOffsets.clear();
+	data.bufferSizes.clear();
+
+	if (TextureContainer::isContainer(fileName))
+	{
+		MappedFile file;
+		CompressedImage image;
+		if (!file.open(fileName) || !TextureContainer::parse(fileName, file.data(), file.size(), image))
+		{
+			std::cerr << "Error loading texture '" << fileName << "'" << std::endl;
+			return false;
+		}
+
+		data.internalFormat = image.internalFormat;
+		data.width = image.width;
+		data.height = image.height;
+		data.levelCount = (GLint)image.levels.size();
+		data.firstLevel = 0;
+		while (maxSize > 0 && data.firstLevel < data.levelCount - 1 &&
+			std::max(image.levels[data.firstLevel].width, image.levels[data.firstLevel].height) > maxSize)
+			data.firstLevel++;
+
+		GLint end = (lastLevel < 0) ? data.levelCount - 1 : std::min(lastLevel, data.levelCount - 1);
+		for (GLint level = data.firstLevel; level <= end; level++)
+		{
+			const CompressedLevel& mip = image.levels[level];
+			data.levels.push_back(std::vector<unsigned char>(file.data() + mip.offset, file.data() + mip.offset + mip.size));
+		}
+		return true;
+	}
+
+	Texture2D image;
+	if (!image.decode(fileName))
+		return false;
+
+	data.internalFormat = GL_RGBA8;
+	data.width = image.mWidth;
+	data.height = image.mHeight;
+	data.levelCount = 1;
+	while ((std::max(data.width, data.height) >> data.levelCount) > 0)
+		data.levelCount++;
+	data.firstLevel = 0;
+	while (maxSize > 0 && data.firstLevel < data.levelCount - 1 &&
+		std::max(std::max(1, data.width >> data.firstLevel), std::max(1, data.height >> data.firstLevel)) > maxSize)
+		data.firstLevel++;
+
+	GLint end = (lastLevel < 0) ? data.levelCount - 1 : std::min(lastLevel, data.levelCount - 1);
+	std::vector<unsigned char> current(image.mImageData, image.mImageData + (size_t)data.width * data.height * 4);
+	int width = data.width, height = data.height;
+	for (GLint level = 0; level <= end; level++)
+	{
+		if (level >= data.firstLevel)
+			data.levels.push_back(current);
+		if (level == end)
+			break;
+
+		std::vector<unsigned char> next;
+		halveImage(current, width, height, next);
+		current.swap(next);
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Prximo nvel de mipmap de uma imagem RGBA: mdia de 2x2 texels (a ltima
+// linha/coluna se repete em tamanhos mpares)
+//-----------------------------------------------------------------------------
+void Texture2D::halveImage(const std::vector<unsigned char>& image, int width, int height, std::vector<unsigned char>& half)
+{
+	int halfWidth = std::max(1, width / 2), halfHeight = std::max(1, height / 2);
+	half.resize((size_t)halfWidth * halfHeight * 4);
+	for (int y = 0; y < halfHeight; y++)
+	{
+		const unsigned char* row0 = &image[(size_t)std::min(y * 2, height - 1) * width * 4];
+		const unsigned char* row1 = &image[(size_t)std::min(y * 2 + 1, height - 1) * width * 4];
+		for (int x = 0; x < halfWidth; x++)
+		{
+			int x0 = std::min(x * 2, width - 1) * 4, x1 = std::min(x * 2 + 1, width - 1) * 4;
+			for (int c = 0; c < 4; c++)
+				half[((size_t)y * halfWidth + x) * 4 + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Envia nveis lidos por readLevels. A primeira chamada cria a textura; as
+// seguintes devem trazer os nveis logo acima dos residentes. O nvel base
+// desce at o mais fino enviado. Nveis num pixel unpack buffer so lidos
+// dele pela GPU, sem cpia na chamada.
+//-----------------------------------------------------------------------------
+bool Texture2D::uploadLevels(const TextureMipData& data)
+{
+	// Sem nveis residentes e nada lido: nem a cauda do arquivo carregou
+	GLint count = (GLint)(data.pixelBuffer != 0 ? data.bufferSizes.size() : data.levels.size());
+	if (mTexture == 0 && count == 0)
+	{
+		mFailed = true;
+		return false;
+	}
+
+	if (mTexture == 0)
+	{
+		glGenTextures(1, &mTexture);
+		GLState::bindTexture(GL_TEXTURE_2D, 0, mTexture);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, data.levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, data.levelCount - 1);
+
+		mStreamFormat = data.internalFormat;
+		mWidth = data.width;
+		mHeight = data.height;
+		mLevelCount = data.levelCount;
+		mBaseLevel = data.levelCount;
+	}
+	else
+		GLState::bindTexture(GL_TEXTURE_2D, 0, mTexture);
+
+	bool contiguous = data.internalFormat == mStreamFormat && data.width == mWidth && data.height == mHeight &&
+		count > 0 && data.firstLevel + count >= mBaseLevel;
+	if (contiguous)
+	{
+		// Com o buffer ligado, o ponteiro das chamadas  o offset dentro dele
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, data.pixelBuffer);
+		for (GLint level = data.firstLevel; level < mBaseLevel; level++)
+		{
+			size_t index = level - data.firstLevel;
+			const void* pixels = (data.pixelBuffer != 0) ? (const void*)data.bufferOffsets[index] : data.levels[index].data();
+			GLsizei size = (GLsizei)(data.pixelBuffer != 0 ? data.bufferSizes[index] : data.levels[index].size());
+			GLsizei width = std::max(1, mWidth >> level), height = std::max(1, mHeight >> level);
+			if (mStreamFormat == GL_RGBA8)
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			else
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, mStreamFormat, width, height, 0, size, pixels);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		// Nveis mais grossos que chegaram de novo ficam como esto
+		mBaseLevel = std::min(mBaseLevel, data.firstLevel);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mBaseLevel);
+	}
+
+	GLState::bindTexture(GL_TEXTURE_2D, 0, 0);
+	return contiguous;
+}
+
+//-----------------------------------------------------------------------------
+// Libera os nveis abaixo de baseLevel: sobem o nvel base e so redefinidos
+// com tamanho 0, o que devolve a memria ao driver
+//-----------------------------------------------------------------------------
+void Texture2D::evictLevels(GLint baseLevel)
+{
+	baseLevel = std::min(baseLevel, mLevelCount - 1);
+	if (mTexture == 0 || baseLevel <= mBaseLevel)
+		return;
+
+	GLState::bindTexture(GL_TEXTURE_2D, 0, mTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+	for (GLint level = mBaseLevel; level < baseLevel; level++)
+	{
+		if (mStreamFormat == GL_RGBA8)
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		else
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, mStreamFormat, 0, 0, 0, 0, NULL);
+	}
+	GLState::bindTexture(GL_TEXTURE_2D, 0, 0);
+
+	mBaseLevel = baseLevel;
+}
+
+//-----------------------------------------------------------------------------
+// Bytes de um nvel de uma textura com streaming
+//-----------------------------------------------------------------------------
+size_t Texture2D::getLevelBytes(GLint level) const
+{
+	GLsizei width = std::max(1, mWidth >> level), height = std::max(1, mHeight >> level);
+	if (mStreamFormat == GL_RGBA8)
+		return (size_t)width * height * 4;
+	return TextureContainer::getLevelSize(mStreamFormat, width, height);
+}
+
+//-----------------------------------------------------------------------------
+// Memria de vdeo dos nveis residentes de uma textura com streaming
+//-----------------------------------------------------------------------------
+size_t Texture2D::getResidentBytes() const
+{
+	size_t bytes = 0;
+	for (GLint level = mBaseLevel; level < mLevelCount; level++)
+		bytes += getLevelBytes(level);
+	return bytes;
 }
@@ -2,9 +2,29 @@
 #define TEXTURE2D_H
 
 #include "GL/glew.h"
+#include "TextureContainer.h"
 #include <string>
+#include <vector>
 using std::string;
 
+class MappedFile;
+
+// Mip levels read by Texture2D::readLevels for uploadLevels
+struct TextureMipData
+{
+	GLenum internalFormat;		// GL_RGBA8, or the compressed format of a KTX/DDS file
+	GLsizei width, height;		// of level 0
+	GLint levelCount;			// in the whole chain
+	GLint firstLevel;			// levels[0] is this level, the rest follow in order
+	std::vector<std::vector<unsigned char> > levels;
+
+	// Set when PixelUploadRing::store moved the levels into a pixel unpack
+	// buffer (levels is empty then): where each one starts and its size
+	GLuint pixelBuffer;
+	std::vector<size_t> bufferOffsets;
+	std::vector<size_t> bufferSizes;
+};
+
 class Texture2D
 {
 public:
@@ -12,6 +32,47 @@ public:
 	virtual ~Texture2D();
 
 	bool loadTexture(const string& fileName, bool generateMipMaps = true);
+
+	// loadTexture in two steps: decode has no GL calls and may run on any
+	// thread, upload creates the texture on the GL thread
+	bool decode(const string& fileName);
+	bool upload(bool generateMipMaps = true);
+	bool isLoaded() const { return mTexture != 0; }
+
+	// Size of an image file read from its header, without decoding it
+	static bool readSize(const string& fileName, int& width, int& height);
+
+	// The last upload (or uploadLevels of a texture with no levels yet) found
+	// nothing to upload: the file is missing or can't be decoded
+	bool hasFailed() const { return mFailed; }
+
+	// The decoded image between decode and upload: RGBA, bottom row first.
+	// NULL for KTX/DDS files.
+	const unsigned char* getImageData() const { return mImageData; }
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+
+	// Streaming: levels are uploaded from the smallest up as they arrive and
+	// GL_TEXTURE_BASE_LEVEL hides the ones that aren't.  readLevels has no GL
+	// calls; it reads from the first level no larger than maxSize (0: level 0)
+	// to lastLevel (-1: the smallest).  uploadLevels must continue the resident
+	// levels upwards, evictLevels frees the ones below baseLevel.
+	static bool readLevels(const string& fileName, GLsizei maxSize, GLint lastLevel, TextureMipData& data);
+	bool uploadLevels(const TextureMipData& data);
+	void evictLevels(GLint baseLevel);
+	GLint getBaseLevel() const { return mBaseLevel; }
+	GLint getLevelCount() const { return mLevelCount; }
+	size_t getResidentBytes() const;
+	size_t getLevelBytes(GLint level) const;
+
+	// Next mip level of an RGBA image (width x height): averages of 2x2
+	// texels, the last row / column repeated on odd sizes, as glGenerateMipmap
+	static void halveImage(const std::vector<unsigned char>& image, int width, int height, std::vector<unsigned char>& half);
+
+	// Decodes all files in parallel, then uploads them; returns how many loaded
+	static size_t loadTextures(const std::vector<Texture2D*>& textures, const std::vector<string>& fileNames,
+		bool generateMipMaps = true);
+
 	void bind(GLuint texUnit = 0);
 	void unbind(GLuint texUnit = 0);
 
@@ -19,6 +80,20 @@ private:
 	Texture2D(const Texture2D& rhs) {}
 	Texture2D& operator = (const Texture2D& rhs) {}
 
+	bool uploadCompressed();
+
 	GLuint mTexture;
+	bool mFailed;
+	unsigned char* mImageData;
+	int mWidth, mHeight;
+
+	// Streamed textures: format, chain length and finest resident level
+	GLenum mStreamFormat;
+	GLint mLevelCount;
+	GLint mBaseLevel;
+
+	// KTX/DDS between decode and upload: the mapped file and where its levels are
+	MappedFile* mCompressedFile;
+	CompressedImage mCompressed;
 };
 #endif //TEXTURE2D_H
@@ -0,0 +1,153 @@
+#include "TextureArray.h"
+#include "Texture2D.h"
+#include "GLState.h"
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+TextureArray::TextureArray()
+	: mTexture(0),
+	mWidth(0),
+	mHeight(0),
+	mLayerCount(0),
+	mLevelCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+TextureArray::~TextureArray()
+{
+	GLState::deleteTexture(mTexture);
+}
+
+//-----------------------------------------------------------------------------
+// Allocates every layer (and its mip chain); layers read black until set
+//-----------------------------------------------------------------------------
+bool TextureArray::create(GLsizei width, GLsizei height, GLsizei layerCount, bool generateMipMaps)
+{
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if (width <= 0 || height <= 0 || layerCount <= 0 || layerCount > maxLayers)
+	{
+		std::cerr << "Invalid texture array size " << width << "x" << height << "x" << layerCount << std::endl;
+		return false;
+	}
+
+	GLState::deleteTexture(mTexture);
+	glGenTextures(1, &mTexture);
+	GLState::bindTexture(GL_TEXTURE_2D_ARRAY, 0, mTexture);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, generateMipMaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	GLint levels = 1;
+	if (generateMipMaps)
+	{
+		while ((std::max(width, height) >> levels) > 0)
+			levels++;
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+	for (GLint level = 0; level < levels; level++)
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, std::max(1, width >> level), std::max(1, height >> level),
+			layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+
+	GLState::bindTexture(GL_TEXTURE_2D_ARRAY, 0, 0);
+
+	mWidth = width;
+	mHeight = height;
+	mLayerCount = layerCount;
+	mLevelCount = levels;
+	mLayerLoaded.assign(layerCount, 0);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Uploads a decoded image to a layer with its mip levels.  The levels are
+// box filtered here, for this layer only: glGenerateMipmap would redo every
+// layer on each call, and layers arrive one at a time from the AssetLoader.
+//-----------------------------------------------------------------------------
+bool TextureArray::setLayer(GLint layer, const Texture2D& image)
+{
+	if (mTexture == 0 || layer < 0 || layer >= mLayerCount)
+		return false;
+
+	const unsigned char* pixels = image.getImageData();
+	if (pixels == NULL)
+	{
+		std::cerr << "Texture array layers need an uncompressed decoded image" << std::endl;
+		return false;
+	}
+
+	if (image.getWidth() != mWidth || image.getHeight() != mHeight)
+	{
+		std::cerr << "A " << image.getWidth() << "x" << image.getHeight() << " image doesn't fit a "
+			<< mWidth << "x" << mHeight << " texture array" << std::endl;
+		return false;
+	}
+
+	GLState::bindTexture(GL_TEXTURE_2D_ARRAY, 0, mTexture);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, mWidth, mHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	if (mLevelCount > 1)
+	{
+		std::vector<unsigned char> current(pixels, pixels + (size_t)mWidth * mHeight * 4), next;
+		int width = mWidth, height = mHeight;
+		for (GLint level = 1; level < mLevelCount; level++)
+		{
+			Texture2D::halveImage(current, width, height, next);
+			current.swap(next);
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, current.data());
+		}
+	}
+	GLState::bindTexture(GL_TEXTURE_2D_ARRAY, 0, 0);
+
+	mLayerLoaded[layer] = 1;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Decodes an image file into a layer
+//-----------------------------------------------------------------------------
+bool TextureArray::loadLayer(GLint layer, const std::string& fileName)
+{
+	Texture2D image;
+	return image.decode(fileName) && setLayer(layer, image);
+}
+
+//-----------------------------------------------------------------------------
+// Whether a layer got its image
+//-----------------------------------------------------------------------------
+bool TextureArray::isLayerLoaded(GLint layer) const
+{
+	return layer >= 0 && layer < mLayerCount && mLayerLoaded[layer] != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Binds the array to a texture unit
+//-----------------------------------------------------------------------------
+void TextureArray::bind(GLuint texUnit)
+{
+	assert(texUnit < 32);
+
+	GLState::bindTexture(GL_TEXTURE_2D_ARRAY, texUnit, mTexture);
+}
+
+//-----------------------------------------------------------------------------
+// Unbinds the array from a texture unit
+//-----------------------------------------------------------------------------
+void TextureArray::unbind(GLuint texUnit)
+{
+	GLState::bindTexture(GL_TEXTURE_2D_ARRAY, texUnit, 0);
+}
@@ -0,0 +1,55 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <vector>
+#include <string>
+
+#include "GL/glew.h"
+
+class Texture2D;
+
+//--------------------------------------------------------------
+// Texture Array
+//
+// A GL_TEXTURE_2D_ARRAY whose layers are filled from images
+// decoded by Texture2D::decode.  Every layer has the array's
+// size, and only images of exactly that size are accepted:
+// group textures into arrays by size rather than scaling them.
+// Objects sample it with (uv, layer), so draws that differ
+// only in their texture keep the same binding and can share a
+// draw call (see MeshArena::addDraw).
+//--------------------------------------------------------------
+class TextureArray
+{
+public:
+	TextureArray();
+	~TextureArray();
+
+	bool create(GLsizei width, GLsizei height, GLsizei layerCount, bool generateMipMaps = true);
+
+	// Copies a decoded image of the array's size into a layer (GL thread); the
+	// image keeps its data
+	bool setLayer(GLint layer, const Texture2D& image);
+
+	// decode + setLayer
+	bool loadLayer(GLint layer, const std::string& fileName);
+
+	bool isLayerLoaded(GLint layer) const;
+
+	void bind(GLuint texUnit = 0);
+	void unbind(GLuint texUnit = 0);
+
+	GLsizei getWidth() const { return mWidth; }
+	GLsizei getHeight() const { return mHeight; }
+	GLsizei getLayerCount() const { return mLayerCount; }
+
+private:
+	TextureArray(const TextureArray& rhs);
+	TextureArray& operator = (const TextureArray& rhs);
+
+	GLuint mTexture;
+	GLsizei mWidth, mHeight, mLayerCount;
+	GLint mLevelCount;
+	std::vector<char> mLayerLoaded;
+};
+#endif //TEXTUREARRAY_H
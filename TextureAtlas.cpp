@@ -0,0 +1,197 @@
+#include "TextureAtlas.h"
+#include "Texture2D.h"
+#include "GLState.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+
+static inline GLsizei alignUp(GLsizei value, GLsizei alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+TextureAtlas::TextureAtlas()
+	: mTexture(0),
+	mWidth(0),
+	mHeight(0),
+	mPadding(0),
+	mMaxLevel(0),
+	mAlignment(1),
+	mShelfX(0),
+	mShelfY(0),
+	mShelfHeight(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+TextureAtlas::~TextureAtlas()
+{
+	GLState::deleteTexture(mTexture);
+}
+
+//-----------------------------------------------------------------------------
+// Allocates an empty width x height atlas with every mip level
+//-----------------------------------------------------------------------------
+bool TextureAtlas::create(GLsizei width, GLsizei height, GLsizei padding)
+{
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	if (width <= 0 || height <= 0 || width > maxSize || height > maxSize || padding < 0)
+	{
+		std::cerr << "Invalid texture atlas size " << width << "x" << height << std::endl;
+		return false;
+	}
+
+	mMaxLevel = getMaxLevel(padding);
+
+	GLState::deleteTexture(mTexture);
+	glGenTextures(1, &mTexture);
+	GLState::bindTexture(GL_TEXTURE_2D, 0, mTexture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mMaxLevel > 0 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mMaxLevel);
+	for (GLint level = 0; level <= mMaxLevel; level++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, std::max(1, width >> level), std::max(1, height >> level), 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+
+	GLState::bindTexture(GL_TEXTURE_2D, 0, 0);
+
+	mWidth = width;
+	mHeight = height;
+	mPadding = padding;
+	mAlignment = 1 << mMaxLevel;
+	mShelfX = mShelfY = mShelfHeight = 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Places a decoded image and uploads it with its padding.  Cells start and
+// end on multiples of 2^mMaxLevel, so each level of the cell is exactly half
+// the one before and is filtered here, without touching the other images.
+//-----------------------------------------------------------------------------
+bool TextureAtlas::add(const Texture2D& image, glm::vec4& uvTransform)
+{
+	const unsigned char* pixels = image.getImageData();
+	if (mTexture == 0 || pixels == NULL)
+		return false;
+
+	int width = image.getWidth(), height = image.getHeight();
+	GLsizei cellWidth = alignUp(width + 2 * mPadding, mAlignment);
+	GLsizei cellHeight = alignUp(height + 2 * mPadding, mAlignment);
+
+	if (mShelfX + cellWidth > mWidth)
+	{
+		mShelfX = 0;
+		mShelfY += mShelfHeight;
+		mShelfHeight = 0;
+	}
+	if (mShelfX + cellWidth > mWidth || mShelfY + cellHeight > mHeight)
+	{
+		std::cerr << "Texture atlas full" << std::endl;
+		return false;
+	}
+
+	// The whole cell: the image at (padding, padding), its edge texels repeated to the cell's borders
+	std::vector<unsigned char> cell((size_t)cellWidth * cellHeight * 4);
+	for (GLsizei y = 0; y < cellHeight; y++)
+	{
+		int sourceY = std::min(std::max(y - mPadding, 0), height - 1);
+		const unsigned char* row = pixels + (size_t)sourceY * width * 4;
+		unsigned char* out = &cell[(size_t)y * cellWidth * 4];
+		for (GLsizei x = 0; x < mPadding; x++)
+			memcpy(out + x * 4, row, 4);
+		memcpy(out + mPadding * 4, row, (size_t)width * 4);
+		for (GLsizei x = mPadding + width; x < cellWidth; x++)
+			memcpy(out + x * 4, row + (width - 1) * 4, 4);
+	}
+
+	GLState::bindTexture(GL_TEXTURE_2D, 0, mTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, mShelfX, mShelfY, cellWidth, cellHeight, GL_RGBA, GL_UNSIGNED_BYTE, cell.data());
+	std::vector<unsigned char> next;
+	for (GLint level = 1; level <= mMaxLevel; level++)
+	{
+		Texture2D::halveImage(cell, cellWidth >> (level - 1), cellHeight >> (level - 1), next);
+		cell.swap(next);
+		glTexSubImage2D(GL_TEXTURE_2D, level, mShelfX >> level, mShelfY >> level, cellWidth >> level, cellHeight >> level,
+			GL_RGBA, GL_UNSIGNED_BYTE, cell.data());
+	}
+	GLState::bindTexture(GL_TEXTURE_2D, 0, 0);
+
+	uvTransform = glm::vec4((float)(mShelfX + mPadding) / mWidth, (float)(mShelfY + mPadding) / mHeight,
+		(float)width / mWidth, (float)height / mHeight);
+
+	mShelfX += cellWidth;
+	mShelfHeight = std::max(mShelfHeight, cellHeight);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Decodes an image file into the atlas
+//-----------------------------------------------------------------------------
+bool TextureAtlas::load(const std::string& fileName, glm::vec4& uvTransform)
+{
+	Texture2D image;
+	return image.decode(fileName) && add(image, uvTransform);
+}
+
+//-----------------------------------------------------------------------------
+// Dequantized uvs mapped into an image's region: the region transform is
+// applied after the dequantization
+//-----------------------------------------------------------------------------
+void TextureAtlas::applyTransform(const glm::vec4& uvTransform, glm::vec2& uvOffset, glm::vec2& uvScale)
+{
+	glm::vec2 regionOffset(uvTransform.x, uvTransform.y), regionScale(uvTransform.z, uvTransform.w);
+	uvOffset = regionOffset + regionScale * uvOffset;
+	uvScale = regionScale * uvScale;
+}
+
+//-----------------------------------------------------------------------------
+// Width or height of an image's cell: the image, its padding on both sides,
+// rounded up to the cell alignment
+//-----------------------------------------------------------------------------
+GLsizei TextureAtlas::getCellSize(GLsizei imageSize, GLsizei padding)
+{
+	return alignUp(imageSize + 2 * padding, 1 << getMaxLevel(padding));
+}
+
+//-----------------------------------------------------------------------------
+// Level L shrinks the padding to padding >> L texels; stop before it's gone
+//-----------------------------------------------------------------------------
+GLint TextureAtlas::getMaxLevel(GLsizei padding)
+{
+	GLint level = 0;
+	while ((padding >> (level + 1)) > 0)
+		level++;
+	return level;
+}
+
+//-----------------------------------------------------------------------------
+// Binds the atlas to a texture unit
+//-----------------------------------------------------------------------------
+void TextureAtlas::bind(GLuint texUnit)
+{
+	assert(texUnit < 32);
+
+	GLState::bindTexture(GL_TEXTURE_2D, texUnit, mTexture);
+}
+
+//-----------------------------------------------------------------------------
+// Unbinds the atlas from a texture unit
+//-----------------------------------------------------------------------------
+void TextureAtlas::unbind(GLuint texUnit)
+{
+	GLState::bindTexture(GL_TEXTURE_2D, texUnit, 0);
+}
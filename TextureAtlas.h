@@ -0,0 +1,70 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <string>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+class Texture2D;
+
+//--------------------------------------------------------------
+// Texture Atlas
+//
+// Packs small images into one GL_TEXTURE_2D, shelf by shelf.
+// Each image gets a uv transform (atlas uv = xy + zw * uv) for
+// MeshArena::addDraw.  The uvOffset / uvScale uniforms already
+// carry a mesh's texcoord dequantization, so for them compose
+// the two with applyTransform instead of writing the transform.
+//
+// Every image is surrounded by padding texels copied from its
+// edges, and mipmaps stop at the level where that padding is one
+// texel wide, so neighbours never bleed into each other.  Each
+// image's levels are built when it is added.  Images can't
+// repeat: use it for textures whose uvs stay in 0..1, and
+// TextureArray for tiling ones.
+//--------------------------------------------------------------
+class TextureAtlas
+{
+public:
+	TextureAtlas();
+	~TextureAtlas();
+
+	bool create(GLsizei width, GLsizei height, GLsizei padding = 4);
+
+	// Copies a decoded image in with its mip levels (GL thread); false if it doesn't fit
+	bool add(const Texture2D& image, glm::vec4& uvTransform);
+
+	// decode + add
+	bool load(const std::string& fileName, glm::vec4& uvTransform);
+
+	void bind(GLuint texUnit = 0);
+	void unbind(GLuint texUnit = 0);
+
+	GLsizei getWidth() const { return mWidth; }
+	GLsizei getHeight() const { return mHeight; }
+
+	// Atlas texels an image side takes with its padding, to size an atlas
+	// that holds a known set of images
+	static GLsizei getCellSize(GLsizei imageSize, GLsizei padding = 4);
+
+	// Folds a uv transform into a texcoord dequantization (offset, scale):
+	// offset = xy + zw * offset, scale = zw * scale
+	static void applyTransform(const glm::vec4& uvTransform, glm::vec2& uvOffset, glm::vec2& uvScale);
+
+private:
+	TextureAtlas(const TextureAtlas& rhs);
+	TextureAtlas& operator = (const TextureAtlas& rhs);
+
+	static GLint getMaxLevel(GLsizei padding);
+
+	GLuint mTexture;
+	GLsizei mWidth, mHeight;
+	GLsizei mPadding;
+	GLint mMaxLevel;
+	GLsizei mAlignment;		// images start at multiples of this, 2^mMaxLevel
+
+	// Images fill the current shelf left to right; the next shelf starts above its tallest
+	GLsizei mShelfX, mShelfY, mShelfHeight;
+};
+#endif //TEXTUREATLAS_H
@@ -0,0 +1,274 @@
+#include "TextureContainer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+
+// KTX 1 file identifier: "\xABKTX 11\xBB\r\n\x1A\n"
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const GLuint KTX_ENDIANNESS = 0x04030201;
+static const size_t KTX_HEADER_SIZE = 64;
+
+// DDS header fields used here
+static const GLuint DDS_MAGIC = 0x20534444;			// "DDS "
+static const size_t DDS_HEADER_SIZE = 4 + 124;
+static const size_t DDS_DX10_HEADER_SIZE = 20;
+static const GLuint DDSD_MIPMAPCOUNT = 0x20000;
+static const GLuint DDPF_FOURCC = 0x4;
+static const GLuint DDSCAPS2_CUBEMAP = 0x200;
+static const GLuint DDSCAPS2_VOLUME = 0x200000;
+static const GLuint D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+// DXGI_FORMAT values of the formats handled
+static const GLuint DXGI_FORMAT_BC1_UNORM = 71;
+static const GLuint DXGI_FORMAT_BC1_UNORM_SRGB = 72;
+static const GLuint DXGI_FORMAT_BC3_UNORM = 77;
+static const GLuint DXGI_FORMAT_BC3_UNORM_SRGB = 78;
+static const GLuint DXGI_FORMAT_BC5_UNORM = 83;
+static const GLuint DXGI_FORMAT_BC7_UNORM = 98;
+static const GLuint DXGI_FORMAT_BC7_UNORM_SRGB = 99;
+
+static inline GLuint readU32(const char* data, size_t offset)
+{
+	GLuint value;
+	memcpy(&value, data + offset, sizeof(value));
+	return value;
+}
+
+static inline GLuint fourCC(char a, char b, char c, char d)
+{
+	return (GLuint)(unsigned char)a | ((GLuint)(unsigned char)b << 8) | ((GLuint)(unsigned char)c << 16) | ((GLuint)(unsigned char)d << 24);
+}
+
+//-----------------------------------------------------------------------------
+// Case insensitive file name extension test
+//-----------------------------------------------------------------------------
+static bool hasExtension(const std::string& fileName, const char* extension)
+{
+	size_t length = strlen(extension);
+	if (fileName.size() < length)
+		return false;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		if (tolower((unsigned char)fileName[fileName.size() - length + i]) != extension[i])
+			return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Whether the file is a container this class reads
+//-----------------------------------------------------------------------------
+bool TextureContainer::isContainer(const std::string& fileName)
+{
+	return hasExtension(fileName, ".ktx") || hasExtension(fileName, ".dds");
+}
+
+//-----------------------------------------------------------------------------
+// Parses a KTX or DDS file by its extension
+//-----------------------------------------------------------------------------
+bool TextureContainer::parse(const std::string& fileName, const char* data, size_t size, CompressedImage& image)
+{
+	bool parsed = false;
+	if (hasExtension(fileName, ".ktx"))
+		parsed = parseKTX(data, size, image);
+	else if (hasExtension(fileName, ".dds"))
+		parsed = parseDDS(data, size, image);
+
+	if (!parsed)
+		std::cerr << "Unsupported or invalid texture container '" << fileName << "'" << std::endl;
+	return parsed;
+}
+
+//-----------------------------------------------------------------------------
+// Fills in the levels of a tightly packed mip chain starting at offset
+// (DDS), checking that it fits in the file
+//-----------------------------------------------------------------------------
+static bool addPackedLevels(CompressedImage& image, GLuint levelCount, size_t offset, size_t fileSize)
+{
+	image.levels.clear();
+	for (GLuint level = 0; level < levelCount; level++)
+	{
+		CompressedLevel mip;
+		mip.width = std::max(1, image.width >> level);
+		mip.height = std::max(1, image.height >> level);
+		mip.offset = offset;
+		mip.size = TextureContainer::getLevelSize(image.internalFormat, mip.width, mip.height);
+		if (mip.offset + mip.size > fileSize)
+			return false;
+
+		image.levels.push_back(mip);
+		offset += mip.size;
+
+		if (mip.width == 1 && mip.height == 1)
+			break;
+	}
+	return !image.levels.empty();
+}
+
+//-----------------------------------------------------------------------------
+// KTX 1: 64 byte header, key/value data, then per level a 32 bit size and
+// the level's data padded to 4 bytes
+//-----------------------------------------------------------------------------
+bool TextureContainer::parseKTX(const char* data, size_t size, CompressedImage& image)
+{
+	if (size < KTX_HEADER_SIZE || memcmp(data, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+		return false;
+
+	// Only files written little endian, with a compressed 2D image (glType 0)
+	if (readU32(data, 12) != KTX_ENDIANNESS || readU32(data, 16) != 0)
+		return false;
+
+	image.internalFormat = readU32(data, 28);
+	image.width = (GLsizei)readU32(data, 36);
+	image.height = (GLsizei)readU32(data, 40);
+	GLuint depth = readU32(data, 44);
+	GLuint arrayElements = readU32(data, 48);
+	GLuint faces = readU32(data, 52);
+	GLuint levelCount = std::max(1u, readU32(data, 56));
+	size_t keyValueBytes = readU32(data, 60);
+
+	if (getBlockSize(image.internalFormat) == 0 || image.width <= 0 || image.height <= 0 ||
+		depth > 1 || arrayElements > 0 || faces != 1)
+		return false;
+
+	size_t offset = KTX_HEADER_SIZE + keyValueBytes;
+	image.levels.clear();
+	for (GLuint level = 0; level < levelCount; level++)
+	{
+		if (offset + 4 > size)
+			return false;
+
+		CompressedLevel mip;
+		mip.width = std::max(1, image.width >> level);
+		mip.height = std::max(1, image.height >> level);
+		mip.size = readU32(data, offset);
+		mip.offset = offset + 4;
+		if (mip.size != getLevelSize(image.internalFormat, mip.width, mip.height) || mip.offset + mip.size > size)
+			return false;
+
+		image.levels.push_back(mip);
+		offset = mip.offset + ((mip.size + 3) & ~(size_t)3);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// DDS: "DDS ", 124 byte header, optional DX10 header, then the levels
+// tightly packed.  Legacy FourCCs DXT1, DXT5 and ATI2/BC5U, or DX10 for
+// BC7 and the sRGB variants.
+//-----------------------------------------------------------------------------
+bool TextureContainer::parseDDS(const char* data, size_t size, CompressedImage& image)
+{
+	if (size < DDS_HEADER_SIZE || readU32(data, 0) != DDS_MAGIC || readU32(data, 4) != 124)
+		return false;
+
+	GLuint flags = readU32(data, 8);
+	image.height = (GLsizei)readU32(data, 12);
+	image.width = (GLsizei)readU32(data, 16);
+	GLuint levelCount = (flags & DDSD_MIPMAPCOUNT) ? std::max(1u, readU32(data, 28)) : 1;
+	GLuint pixelFlags = readU32(data, 80);
+	GLuint pixelFourCC = readU32(data, 84);
+	GLuint caps2 = readU32(data, 112);
+
+	if (!(pixelFlags & DDPF_FOURCC) || (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) || image.width <= 0 || image.height <= 0)
+		return false;
+
+	size_t offset = DDS_HEADER_SIZE;
+	image.internalFormat = 0;
+	if (pixelFourCC == fourCC('D', 'X', 'T', '1'))
+		image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	else if (pixelFourCC == fourCC('D', 'X', 'T', '5'))
+		image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	else if (pixelFourCC == fourCC('A', 'T', 'I', '2') || pixelFourCC == fourCC('B', 'C', '5', 'U'))
+		image.internalFormat = GL_COMPRESSED_RG_RGTC2;
+	else if (pixelFourCC == fourCC('D', 'X', '1', '0'))
+	{
+		if (size < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+			return false;
+
+		GLuint dxgiFormat = readU32(data, offset);
+		GLuint dimension = readU32(data, offset + 4);
+		GLuint arraySize = readU32(data, offset + 12);
+		if (dimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || arraySize > 1)
+			return false;
+
+		switch (dxgiFormat)
+		{
+		case DXGI_FORMAT_BC1_UNORM: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+		case DXGI_FORMAT_BC1_UNORM_SRGB: image.internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT; break;
+		case DXGI_FORMAT_BC3_UNORM: image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+		case DXGI_FORMAT_BC3_UNORM_SRGB: image.internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT; break;
+		case DXGI_FORMAT_BC5_UNORM: image.internalFormat = GL_COMPRESSED_RG_RGTC2; break;
+		case DXGI_FORMAT_BC7_UNORM: image.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+		case DXGI_FORMAT_BC7_UNORM_SRGB: image.internalFormat = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM; break;
+		default: return false;
+		}
+		offset += DDS_DX10_HEADER_SIZE;
+	}
+	else
+		return false;
+
+	return addPackedLevels(image, levelCount, offset, size);
+}
+
+//-----------------------------------------------------------------------------
+// Bytes per 4x4 block: 8 for BC1, 16 for BC3, BC5 and BC7
+//-----------------------------------------------------------------------------
+GLsizei TextureContainer::getBlockSize(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		return 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Size of one level; partial blocks at the edges count as whole blocks
+//-----------------------------------------------------------------------------
+size_t TextureContainer::getLevelSize(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	size_t blocksWide = (size_t)std::max(1, (width + 3) / 4);
+	size_t blocksHigh = (size_t)std::max(1, (height + 3) / 4);
+	return blocksWide * blocksHigh * getBlockSize(internalFormat);
+}
+
+//-----------------------------------------------------------------------------
+// BC1/BC3 need EXT_texture_compression_s3tc (plus EXT_texture_sRGB for sRGB),
+// BC5 is core since 3.0 and BC7 needs 4.2 or ARB_texture_compression_bptc
+//-----------------------------------------------------------------------------
+bool TextureContainer::isSupported(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return GLEW_EXT_texture_compression_s3tc != 0;
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+	case GL_COMPRESSED_RG_RGTC2:
+		return true;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef TEXTURECONTAINER_H
+#define TEXTURECONTAINER_H
+
+#include <vector>
+#include <string>
+
+#include "GL/glew.h"
+
+
+// One mip level of a block compressed image, as a byte range of the file
+struct CompressedLevel
+{
+	GLsizei width;
+	GLsizei height;
+	size_t offset;
+	size_t size;
+};
+
+// A block compressed 2D image with its mip chain, level 0 first
+struct CompressedImage
+{
+	GLenum internalFormat;	// GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, ...
+	GLsizei width;
+	GLsizei height;
+	std::vector<CompressedLevel> levels;
+};
+
+//--------------------------------------------------------------
+// Texture Container
+//
+// Reads the layout of KTX (version 1) and DDS files holding a single
+// 2D image in BC1, BC3, BC5 or BC7, sRGB variants included.  Only
+// offsets into the file are produced, so the levels can be handed
+// to glCompressedTexImage2D straight from a mapped file.  Images
+// are used as stored: the first block row is the bottom of the
+// texture, as GL expects (the texture baker writes them that way).
+//--------------------------------------------------------------
+class TextureContainer
+{
+public:
+
+	// .ktx or .dds, by file name extension
+	static bool isContainer(const std::string& fileName);
+
+	static bool parse(const std::string& fileName, const char* data, size_t size, CompressedImage& image);
+	static bool parseKTX(const char* data, size_t size, CompressedImage& image);
+	static bool parseDDS(const char* data, size_t size, CompressedImage& image);
+
+	// Bytes per 4x4 block, 0 for formats not handled
+	static GLsizei getBlockSize(GLenum internalFormat);
+	static size_t getLevelSize(GLenum internalFormat, GLsizei width, GLsizei height);
+
+	// Whether the current context can sample the format
+	static bool isSupported(GLenum internalFormat);
+};
+#endif //TEXTURECONTAINER_H
@@ -0,0 +1,289 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------
+// Constructor: starts the workers
+//-----------------------------------------------------------------------------
+TextureStreamer::TextureStreamer(size_t budgetBytes, unsigned int threadCount)
+	: mBudget(budgetBytes),
+	mPendingBytes(0),
+	mFrame(1),
+	mPending(0),
+	mStopping(false)
+{
+	mUploadRing.create(STREAMING_SLOT_BYTES, STREAMING_UPLOAD_SLOTS);
+
+	threadCount = std::max(1u, threadCount);
+	for (unsigned int i = 0; i < threadCount; i++)
+		mWorkers.push_back(std::thread(&TextureStreamer::workerLoop, this));
+}
+
+//-----------------------------------------------------------------------------
+// Destructor: drops reads not started yet and joins the workers
+//-----------------------------------------------------------------------------
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+		mJobs.clear();
+	}
+	mJobReady.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); i++)
+		mWorkers[i].join();
+}
+
+//-----------------------------------------------------------------------------
+// Registers a texture and queues the read of its tail
+//-----------------------------------------------------------------------------
+void TextureStreamer::add(const TextureHandle& texture, const std::string& filename)
+{
+	if (!texture || mEntries.count(texture.get()) > 0)
+		return;
+
+	Entry entry = { texture, filename, 0.0f, 0, true, 0 };
+	mEntries[texture.get()] = entry;
+
+	Job job = { texture.get(), filename, STREAMING_TAIL_SIZE, -1, false, TextureMipData() };
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(job);
+		mPending++;
+	}
+	mJobReady.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// Records that a texture is on screen; several requests in a frame keep the
+// largest
+//-----------------------------------------------------------------------------
+void TextureStreamer::request(const Texture2D* texture, float screenPixels)
+{
+	std::map<const Texture2D*, Entry>::iterator it = mEntries.find(texture);
+	if (it == mEntries.end())
+		return;
+
+	Entry& entry = it->second;
+	entry.screenPixels = (entry.lastUsed == mFrame) ? std::max(entry.screenPixels, screenPixels) : screenPixels;
+	entry.lastUsed = mFrame;
+}
+
+//-----------------------------------------------------------------------------
+// Worker thread: reads the levels of each job from its file
+//-----------------------------------------------------------------------------
+void TextureStreamer::workerLoop()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobReady.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+			if (mStopping)
+				return;
+
+			job = mJobs.front();
+			mJobs.pop_front();
+		}
+
+		job.read = Texture2D::readLevels(job.filename, job.maxSize, job.lastLevel, job.data);
+		if (job.read && mUploadRing.isCreated())
+			mUploadRing.store(job.data);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mResults.push_back(job);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Once per frame: uploads what the workers read, frees levels if the
+// budget doesn't cover what the screen needs, and queues reads for the
+// textures furthest from their wanted level
+//-----------------------------------------------------------------------------
+void TextureStreamer::update(size_t uploadBytes)
+{
+	mUploadRing.update();
+
+	// Finished reads, until uploadBytes is spent (the GL calls of a job can't be split)
+	size_t uploaded = 0;
+	while (uploaded < uploadBytes)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mResults.empty())
+				break;
+
+			job = mResults.front();
+			mResults.pop_front();
+			mPending--;
+		}
+
+		Entry& entry = mEntries[job.texture];
+		entry.pending = false;
+		mPendingBytes -= entry.pendingBytes;
+		entry.pendingBytes = 0;
+
+		// A failed read uploads nothing; if it was the tail, uploadLevels marks
+		// the texture failed and the streamer lets go of it
+		mUploadRing.prepare(job.data);
+		bool streamed = job.texture->uploadLevels(job.data);
+		if (!job.read || !streamed)
+			std::cerr << "Failed to stream " << job.filename << std::endl;
+		uploaded += getDataBytes(job.data);
+		mUploadRing.release(job.data);
+
+		if (job.texture->hasFailed())
+			mEntries.erase(job.texture);
+	}
+
+	// What every texture wants against what it has
+	std::vector<Entry*> unused, overResident, missing;
+	size_t used = mPendingBytes;
+	size_t demand = 0;
+	for (std::map<const Texture2D*, Entry>::iterator it = mEntries.begin(); it != mEntries.end(); ++it)
+	{
+		Entry& entry = it->second;
+		const Texture2D& texture = *entry.texture;
+		if (texture.getLevelCount() == 0)
+			continue;
+
+		used += texture.getResidentBytes();
+		if (entry.pending)
+			continue;
+
+		GLint wanted = getWantedLevel(entry);
+		if (entry.lastUsed != mFrame && texture.getBaseLevel() < wanted)
+			unused.push_back(&entry);
+		else if (texture.getBaseLevel() < wanted)
+			overResident.push_back(&entry);
+		else if (texture.getBaseLevel() > wanted)
+		{
+			missing.push_back(&entry);
+			demand += getLevelBytes(texture, wanted, texture.getBaseLevel());
+		}
+	}
+
+	// Make room: textures off screen go back to their tail, oldest first,
+	// then those on screen lose the levels finer than they need
+	std::sort(unused.begin(), unused.end(), [](const Entry* a, const Entry* b) { return a->lastUsed < b->lastUsed; });
+	unused.insert(unused.end(), overResident.begin(), overResident.end());
+	for (size_t i = 0; i < unused.size() && used + demand > mBudget; i++)
+	{
+		Texture2D& texture = *unused[i]->texture;
+		GLint wanted = getWantedLevel(*unused[i]);
+		used -= getLevelBytes(texture, texture.getBaseLevel(), wanted);
+		texture.evictLevels(wanted);
+	}
+
+	// Reads, largest gap first; a texture that doesn't fit whole gets the finest levels that do
+	std::sort(missing.begin(), missing.end(), [this](const Entry* a, const Entry* b)
+	{
+		GLint gapA = a->texture->getBaseLevel() - getWantedLevel(*a);
+		GLint gapB = b->texture->getBaseLevel() - getWantedLevel(*b);
+		return gapA != gapB ? gapA > gapB : a->screenPixels > b->screenPixels;
+	});
+	for (size_t i = 0; i < missing.size() && used < mBudget; i++)
+	{
+		Entry& entry = *missing[i];
+		const Texture2D& texture = *entry.texture;
+		GLint base = texture.getBaseLevel();
+		GLint first = getWantedLevel(entry);
+		size_t bytes = getLevelBytes(texture, first, base);
+		while (first < base && used + bytes > mBudget)
+			bytes -= texture.getLevelBytes(first++);
+		if (first == base)
+			continue;
+
+		GLsizei maxSize = std::max(1, std::max(texture.getWidth() >> first, texture.getHeight() >> first));
+		Job job = { entry.texture.get(), entry.filename, maxSize, base - 1, false, TextureMipData() };
+		entry.pending = true;
+		entry.pendingBytes = bytes;
+		mPendingBytes += bytes;
+		used += bytes;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJobs.push_back(job);
+			mPending++;
+		}
+		mJobReady.notify_one();
+	}
+
+	mFrame++;
+}
+
+//-----------------------------------------------------------------------------
+// Bytes of the levels a job read, wherever they are
+//-----------------------------------------------------------------------------
+size_t TextureStreamer::getDataBytes(const TextureMipData& data)
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < data.levels.size(); i++)
+		bytes += data.levels[i].size();
+	for (size_t i = 0; i < data.bufferSizes.size(); i++)
+		bytes += data.bufferSizes[i];
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// Finest level of the tail
+//-----------------------------------------------------------------------------
+GLint TextureStreamer::getTailLevel(const Texture2D& texture) const
+{
+	GLint level = 0;
+	while (level < texture.getLevelCount() - 1 &&
+		std::max(texture.getWidth() >> level, texture.getHeight() >> level) > STREAMING_TAIL_SIZE)
+		level++;
+	return level;
+}
+
+//-----------------------------------------------------------------------------
+// Level whose size matches the pixels the texture covers, or the tail if it
+// wasn't requested this frame
+//-----------------------------------------------------------------------------
+GLint TextureStreamer::getWantedLevel(const Entry& entry) const
+{
+	const Texture2D& texture = *entry.texture;
+	GLint tail = getTailLevel(texture);
+	if (entry.lastUsed != mFrame || entry.screenPixels <= 0.0f)
+		return tail;
+
+	float texels = (float)std::max(texture.getWidth(), texture.getHeight());
+	GLint level = (GLint)std::floor(std::log2(std::max(1.0f, texels / entry.screenPixels)));
+	return std::min(level, tail);
+}
+
+//-----------------------------------------------------------------------------
+// Bytes of levels first .. end - 1
+//-----------------------------------------------------------------------------
+size_t TextureStreamer::getLevelBytes(const Texture2D& texture, GLint first, GLint end) const
+{
+	size_t bytes = 0;
+	for (GLint level = first; level < end; level++)
+		bytes += texture.getLevelBytes(level);
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// Resident memory of every streamed texture
+//-----------------------------------------------------------------------------
+size_t TextureStreamer::getResidentBytes() const
+{
+	size_t bytes = 0;
+	for (std::map<const Texture2D*, Entry>::const_iterator it = mEntries.begin(); it != mEntries.end(); ++it)
+		bytes += it->second.texture->getResidentBytes();
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// Reads not uploaded yet
+//-----------------------------------------------------------------------------
+size_t TextureStreamer::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mPending;
+}
@@ -0,0 +1,118 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Texture2D.h"
+#include "ResourceManager.h"
+#include "PixelUploadRing.h"
+
+
+// Levels no larger than this are loaded first and never evicted
+const GLsizei STREAMING_TAIL_SIZE = 64;
+
+// Bytes of finished levels uploaded per update(), at least one job's worth
+const size_t STREAMING_UPLOAD_BYTES = 4 * 1024 * 1024;
+
+// Pixel unpack buffers the workers copy levels into; a read that doesn't
+// fit one (or finds none free) is uploaded from client memory instead
+const GLuint STREAMING_UPLOAD_SLOTS = 3;
+const size_t STREAMING_SLOT_BYTES = 8 * 1024 * 1024;
+
+//--------------------------------------------------------------
+// Texture Streamer
+//
+// Keeps only the mip levels the screen needs resident.  Each
+// texture starts with its tail (the levels up to
+// STREAMING_TAIL_SIZE), so it can be drawn right away; every
+// frame the renderer reports how many pixels each texture
+// covers and update() streams finer levels in, on worker
+// threads, until the texel to pixel ratio is about one.
+//
+// Resident levels plus the levels being read stay within a
+// byte budget.  To make room, textures not used this frame
+// drop back to their tail, least recently used first, then
+// visible ones finer than they need are trimmed.
+//
+// Workers copy the levels they read into a PixelUploadRing, so
+// the uploads in update() don't stall on the driver's copy.
+// Create the streamer after the GL context.
+//--------------------------------------------------------------
+class TextureStreamer
+{
+public:
+
+	TextureStreamer(size_t budgetBytes, unsigned int threadCount = 1);
+	~TextureStreamer();
+
+	// Starts streaming a texture that hasn't been loaded; the streamer keeps a handle
+	void add(const TextureHandle& texture, const std::string& filename);
+
+	// The texture covers about screenPixels pixels (its larger side) this frame
+	void request(const Texture2D* texture, float screenPixels);
+
+	// Render thread, once per frame after the requests: uploads finished
+	// levels, evicts and queues reads
+	void update(size_t uploadBytes = STREAMING_UPLOAD_BYTES);
+
+	size_t getBudget() const { return mBudget; }
+	void setBudget(size_t budgetBytes) { mBudget = budgetBytes; }
+
+	// Memory of the resident levels of every texture
+	size_t getResidentBytes() const;
+
+	// Reads queued or not uploaded yet
+	size_t getPendingCount() const;
+
+private:
+	TextureStreamer(const TextureStreamer& rhs);
+	TextureStreamer& operator = (const TextureStreamer& rhs);
+
+	struct Entry
+	{
+		TextureHandle texture;
+		std::string filename;
+		float screenPixels;		// largest request this frame
+		unsigned int lastUsed;	// frame of the last request
+		bool pending;			// a read is in flight
+		size_t pendingBytes;
+	};
+
+	struct Job
+	{
+		Texture2D* texture;
+		std::string filename;
+		GLsizei maxSize;		// first level to read, by size (0: level 0)
+		GLint lastLevel;		// -1: down to 1x1
+		bool read;				// the worker half succeeded
+		TextureMipData data;
+	};
+
+	void workerLoop();
+	GLint getTailLevel(const Texture2D& texture) const;
+	GLint getWantedLevel(const Entry& entry) const;
+	size_t getLevelBytes(const Texture2D& texture, GLint first, GLint end) const;
+	static size_t getDataBytes(const TextureMipData& data);
+
+	std::map<const Texture2D*, Entry> mEntries;
+	size_t mBudget;
+	size_t mPendingBytes;	// levels being read, counted against the budget
+	unsigned int mFrame;
+	PixelUploadRing mUploadRing;
+
+	std::vector<std::thread> mWorkers;
+	std::deque<Job> mJobs;
+	std::deque<Job> mResults;
+	size_t mPending;
+	bool mStopping;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mJobReady;
+};
+#endif //TEXTURESTREAMER_H
@@ -0,0 +1,73 @@
+#include "UniformBuffer.h"
+#include <iostream>
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+UniformBuffer::UniformBuffer()
+	: mHandle(0),
+	mSize(0),
+	mStride(0),
+	mCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &mHandle);
+}
+
+//-----------------------------------------------------------------------------
+// Allocates count slots of size bytes
+//-----------------------------------------------------------------------------
+bool UniformBuffer::create(GLsizeiptr size, GLuint count)
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment <= 0)
+		alignment = 256;
+
+	mSize = size;
+	mStride = (size + alignment - 1) / alignment * alignment;
+	mCount = count;
+
+	if (mHandle == 0)
+		glGenBuffers(1, &mHandle);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, mHandle);
+	glBufferData(GL_UNIFORM_BUFFER, mStride * count, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	if (mHandle == 0)
+	{
+		std::cerr << "Unable to create uniform buffer!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Uploads one slot; data must hold the whole block
+//-----------------------------------------------------------------------------
+void UniformBuffer::update(const void* data, GLuint slot)
+{
+	if (slot >= mCount) return;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, mHandle);
+	glBufferSubData(GL_UNIFORM_BUFFER, slot * mStride, mSize, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Binds one slot to a uniform block binding point
+//-----------------------------------------------------------------------------
+void UniformBuffer::bind(GLuint binding, GLuint slot) const
+{
+	if (slot >= mCount) return;
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, mHandle, slot * mStride, mSize);
+}
@@ -0,0 +1,40 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include "GL/glew.h"
+
+
+// Uniform block binding points shared by every shader program
+const GLuint FRAME_BLOCK_BINDING = 0;		// FrameData: camera and light
+const GLuint MATERIAL_BLOCK_BINDING = 1;	// MaterialData
+
+//--------------------------------------------------------------
+// Uniform Buffer
+//
+// A uniform buffer object holding count slots of one std140 block.
+// Slots start on GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT boundaries so
+// each can be bound on its own with glBindBufferRange, e.g. one
+// slot per material.
+//--------------------------------------------------------------
+class UniformBuffer
+{
+public:
+	UniformBuffer();
+	~UniformBuffer();
+
+	bool create(GLsizeiptr size, GLuint count = 1);
+	void update(const void* data, GLuint slot = 0);
+	void bind(GLuint binding, GLuint slot = 0) const;
+
+	GLsizeiptr getStride() const { return mStride; }
+
+private:
+	UniformBuffer(const UniformBuffer& rhs);
+	UniformBuffer& operator = (const UniformBuffer& rhs);
+
+	GLuint mHandle;
+	GLsizeiptr mSize;
+	GLsizeiptr mStride;
+	GLuint mCount;
+};
+#endif //UNIFORMBUFFER_H
@@ -0,0 +1,185 @@
+#include "VertexPacker.h"
+#include <cstring>
+#include "glm/gtc/packing.hpp"
+
+
+struct HalfVertex
+{
+	GLushort position[4];	// half, w unused
+	GLuint normal;			// snorm 10:10:10:2
+	GLushort texCoords[2];	// unorm16
+};
+
+struct Snorm16Vertex
+{
+	GLshort position[4];	// snorm16, w unused
+	GLshort normal[2];		// octahedral snorm16
+	GLushort texCoords[2];	// unorm16
+};
+
+//-----------------------------------------------------------------------------
+// Returns the vertex buffer layout of a format
+//-----------------------------------------------------------------------------
+VertexLayout VertexPacker::getLayout(VertexFormat format)
+{
+	VertexLayout layout;
+	memset(&layout, 0, sizeof(layout));
+	layout.attributeCount = 3;
+
+	switch (format)
+	{
+	case VERTEX_FORMAT_HALF:
+	{
+		const VertexAttribute attributes[] = {
+			{ 0, 4, GL_HALF_FLOAT, GL_FALSE, 0 },
+			{ 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 4 * sizeof(GLushort) },
+			{ 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(GLushort) + sizeof(GLuint) }
+		};
+		layout.stride = sizeof(HalfVertex);
+		memcpy(layout.attributes, attributes, sizeof(attributes));
+		break;
+	}
+
+	case VERTEX_FORMAT_SNORM16:
+	{
+		const VertexAttribute attributes[] = {
+			{ 0, 4, GL_SHORT, GL_TRUE, 0 },
+			{ 1, 2, GL_SHORT, GL_TRUE, 4 * sizeof(GLshort) },
+			{ 2, 2, GL_UNSIGNED_SHORT, GL_TRUE, 6 * sizeof(GLshort) }
+		};
+		layout.stride = sizeof(Snorm16Vertex);
+		memcpy(layout.attributes, attributes, sizeof(attributes));
+		break;
+	}
+
+	default:
+	{
+		const VertexAttribute attributes[] = {
+			{ 0, 3, GL_FLOAT, GL_FALSE, 0 },
+			{ 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat) },
+			{ 2, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat) }
+		};
+		layout.stride = sizeof(Vertex);
+		memcpy(layout.attributes, attributes, sizeof(attributes));
+		break;
+	}
+	}
+
+	return layout;
+}
+
+//-----------------------------------------------------------------------------
+// Octahedral normal encoding: projects the unit sphere onto an octahedron
+// and unfolds it into the [-1, 1] square
+//-----------------------------------------------------------------------------
+glm::vec2 VertexPacker::encodeOctahedral(const glm::vec3& normal)
+{
+	float length = fabs(normal.x) + fabs(normal.y) + fabs(normal.z);
+	if (length <= 0.0f)
+		return glm::vec2(0.0f);
+
+	glm::vec3 n = normal / length;
+	glm::vec2 e(n.x, n.y);
+
+	if (n.z < 0.0f)
+	{
+		e.x = (1.0f - fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		e.y = (1.0f - fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	return e;
+}
+
+//-----------------------------------------------------------------------------
+// Packs vertices into format.  VERTEX_FORMAT_FLOAT is copied as is and gets
+// an identity dequantization.
+//-----------------------------------------------------------------------------
+void VertexPacker::pack(VertexFormat format, const std::vector<Vertex>& vertices,
+	std::vector<unsigned char>& packed, VertexDequantization& dequantization)
+{
+	dequantization.positionOffset = glm::vec3(0.0f);
+	dequantization.positionScale = glm::vec3(1.0f);
+	dequantization.texCoordOffset = glm::vec2(0.0f);
+	dequantization.texCoordScale = glm::vec2(1.0f);
+	dequantization.octahedralNormals = (format == VERTEX_FORMAT_SNORM16);
+
+	if (format == VERTEX_FORMAT_FLOAT || vertices.empty())
+	{
+		packed.resize(vertices.size() * sizeof(Vertex));
+		if (!vertices.empty())
+			memcpy(&packed[0], &vertices[0], packed.size());
+		return;
+	}
+
+	glm::vec3 minPos = vertices[0].position, maxPos = minPos;
+	glm::vec2 minUV = vertices[0].texCoords, maxUV = minUV;
+	for (size_t i = 1; i < vertices.size(); i++)
+	{
+		minPos = glm::min(minPos, vertices[i].position);
+		maxPos = glm::max(maxPos, vertices[i].position);
+		minUV = glm::min(minUV, vertices[i].texCoords);
+		maxUV = glm::max(maxUV, vertices[i].texCoords);
+	}
+
+	// Positions map to [-1, 1] around the AABB centre, uvs to [0, 1] over their range.
+	// Flat extents keep a scale of 1 so nothing divides by zero.
+	glm::vec3 center = (minPos + maxPos) * 0.5f;
+	glm::vec3 halfExtent = (maxPos - minPos) * 0.5f;
+	glm::vec2 uvRange = maxUV - minUV;
+	for (int i = 0; i < 3; i++)
+	{
+		if (halfExtent[i] <= 0.0f)
+			halfExtent[i] = 1.0f;
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (uvRange[i] <= 0.0f)
+			uvRange[i] = 1.0f;
+	}
+
+	dequantization.positionOffset = center;
+	dequantization.positionScale = halfExtent;
+	dequantization.texCoordOffset = minUV;
+	dequantization.texCoordScale = uvRange;
+
+	if (format == VERTEX_FORMAT_HALF)
+	{
+		packed.resize(vertices.size() * sizeof(HalfVertex));
+		HalfVertex* out = (HalfVertex*)&packed[0];
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			glm::vec3 p = (vertices[i].position - center) / halfExtent;
+			glm::vec2 uv = (vertices[i].texCoords - minUV) / uvRange;
+
+			out[i].position[0] = glm::packHalf1x16(p.x);
+			out[i].position[1] = glm::packHalf1x16(p.y);
+			out[i].position[2] = glm::packHalf1x16(p.z);
+			out[i].position[3] = glm::packHalf1x16(1.0f);
+			out[i].normal = glm::packSnorm3x10_1x2(glm::vec4(vertices[i].normal, 0.0f));
+			out[i].texCoords[0] = glm::packUnorm1x16(uv.x);
+			out[i].texCoords[1] = glm::packUnorm1x16(uv.y);
+		}
+	}
+	else
+	{
+		packed.resize(vertices.size() * sizeof(Snorm16Vertex));
+		Snorm16Vertex* out = (Snorm16Vertex*)&packed[0];
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			glm::vec3 p = (vertices[i].position - center) / halfExtent;
+			glm::vec2 uv = (vertices[i].texCoords - minUV) / uvRange;
+			glm::vec2 n = encodeOctahedral(vertices[i].normal);
+
+			out[i].position[0] = (GLshort)glm::packSnorm1x16(p.x);
+			out[i].position[1] = (GLshort)glm::packSnorm1x16(p.y);
+			out[i].position[2] = (GLshort)glm::packSnorm1x16(p.z);
+			out[i].position[3] = (GLshort)glm::packSnorm1x16(1.0f);
+			out[i].normal[0] = (GLshort)glm::packSnorm1x16(n.x);
+			out[i].normal[1] = (GLshort)glm::packSnorm1x16(n.y);
+			out[i].texCoords[0] = glm::packUnorm1x16(uv.x);
+			out[i].texCoords[1] = glm::packUnorm1x16(uv.y);
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#ifndef VERTEXPACKER_H
+#define VERTEXPACKER_H
+
+#include <vector>
+
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+
+//--------------------------------------------------------------
+// Vertex Packer
+//
+// Converts Vertex arrays to the compressed vertex formats.
+// Positions are stored relative to the mesh AABB and texture
+// coordinates relative to their own range, both normalized to the
+// integer range, so the shader needs the VertexDequantization
+// that comes out of pack() to undo it.
+//--------------------------------------------------------------
+class VertexPacker
+{
+public:
+
+	static VertexLayout getLayout(VertexFormat format);
+
+	static void pack(VertexFormat format, const std::vector<Vertex>& vertices,
+		std::vector<unsigned char>& packed, VertexDequantization& dequantization);
+
+	static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+};
+#endif //VERTEXPACKER_H
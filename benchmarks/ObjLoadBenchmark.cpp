@@ -0,0 +1,203 @@
+//-----------------------------------------------------------------------------
+// OBJ load time benchmark
+//
+// Times ObjLoader (parse and vertex deduplication) against the previous
+// getline/stringstream parser over a set of OBJ files and checks that both
+// produce the same triangles.
+// Does not need an OpenGL context.  From the repository root:
+//
+//   g++ -O2 -std=c++14 -I common/includes -I . benchmarks/ObjLoadBenchmark.cpp ObjLoader.cpp MappedFile.cpp -o objbench
+//   ./objbench models/*.obj
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#include "ObjLoader.h"
+#include "MappedFile.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+//-----------------------------------------------------------------------------
+// The parser Mesh::loadOBJ used before ObjLoader, kept as the reference
+//-----------------------------------------------------------------------------
+static std::vector<std::string> split(std::string s, std::string t)
+{
+	std::vector<std::string> res;
+	while (1)
+	{
+		int pos = s.find(t);
+		if (pos == -1)
+		{
+			res.push_back(s);
+			break;
+		}
+		res.push_back(s.substr(0, pos));
+		s = s.substr(pos + 1, s.size() - pos - 1);
+	}
+	return res;
+}
+
+static bool referenceLoad(const std::string& filename, std::vector<Vertex>& vertices)
+{
+	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+	std::vector<glm::vec3> tempVertices;
+	std::vector<glm::vec2> tempUVs;
+	std::vector<glm::vec3> tempNormals;
+
+	std::ifstream fin(filename, std::ios::in);
+	if (!fin)
+		return false;
+
+	std::string lineBuffer;
+	while (std::getline(fin, lineBuffer))
+	{
+		std::stringstream ss(lineBuffer);
+		std::string cmd;
+		ss >> cmd;
+
+		if (cmd == "v")
+		{
+			glm::vec3 vertex;
+			int dim = 0;
+			while (dim < 3 && ss >> vertex[dim])
+				dim++;
+			tempVertices.push_back(vertex);
+		}
+		else if (cmd == "vt")
+		{
+			glm::vec2 uv;
+			int dim = 0;
+			while (dim < 2 && ss >> uv[dim])
+				dim++;
+			tempUVs.push_back(uv);
+		}
+		else if (cmd == "vn")
+		{
+			glm::vec3 normal;
+			int dim = 0;
+			while (dim < 3 && ss >> normal[dim])
+				dim++;
+			tempNormals.push_back(glm::normalize(normal));
+		}
+		else if (cmd == "f")
+		{
+			std::string faceData;
+			int index;
+			while (ss >> faceData)
+			{
+				std::vector<std::string> data = split(faceData, "/");
+				if (data[0].size() > 0 && sscanf(data[0].c_str(), "%d", &index) == 1)
+					vertexIndices.push_back(index);
+				if (data.size() > 1 && data[1].size() > 0 && sscanf(data[1].c_str(), "%d", &index) == 1)
+					uvIndices.push_back(index);
+				if (data.size() > 2 && data[2].size() > 0 && sscanf(data[2].c_str(), "%d", &index) == 1)
+					normalIndices.push_back(index);
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < vertexIndices.size(); i++)
+	{
+		Vertex meshVertex;
+		if (tempVertices.size() > 0)
+			meshVertex.position = tempVertices[vertexIndices[i] - 1];
+		if (tempNormals.size() > 0 && i < normalIndices.size())
+			meshVertex.normal = tempNormals[normalIndices[i] - 1];
+		if (tempUVs.size() > 0 && i < uvIndices.size())
+			meshVertex.texCoords = tempUVs[uvIndices[i] - 1];
+		vertices.push_back(meshVertex);
+	}
+
+	return true;
+}
+
+static bool fastLoad(const std::string& filename, std::vector<Vertex>& vertices)
+{
+	MappedFile file;
+	if (!file.open(filename))
+		return false;
+
+	ObjData data;
+	std::vector<Vertex> unique;
+	std::vector<GLuint> indices;
+	ObjLoader::parse(file.data(), file.data() + file.size(), data);
+	ObjLoader::buildIndexedVertices(data, unique, indices);
+
+	// Expanded again only so the output can be compared with the reference
+	vertices.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+		vertices[i] = unique[indices[i]];
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Best of n runs, in milliseconds
+//-----------------------------------------------------------------------------
+template <typename LoadFn>
+static double timeLoad(LoadFn load, const std::string& filename, int runs, std::vector<Vertex>& vertices)
+{
+	double best = 1e30;
+	for (int i = 0; i < runs; i++)
+	{
+		vertices.clear();
+		Clock::time_point start = Clock::now();
+		load(filename, vertices);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++)
+		files.push_back(argv[i]);
+
+	if (files.empty())
+	{
+		std::cerr << "Usage: objbench file.obj [file.obj ...]" << std::endl;
+		return 1;
+	}
+
+	const int runs = 10;
+	double totalReference = 0.0, totalFast = 0.0;
+	bool allMatch = true;
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << std::left << std::setw(28) << "file" << std::right
+		<< std::setw(10) << "vertices" << std::setw(14) << "stream (ms)"
+		<< std::setw(14) << "loader (ms)" << std::setw(10) << "speedup" << "  output" << std::endl;
+
+	for (size_t f = 0; f < files.size(); f++)
+	{
+		std::vector<Vertex> reference, fast;
+		double referenceMs = timeLoad(referenceLoad, files[f], runs, reference);
+		double fastMs = timeLoad(fastLoad, files[f], runs, fast);
+
+		bool match = reference.size() == fast.size() &&
+			(fast.empty() || memcmp(&reference[0], &fast[0], fast.size() * sizeof(Vertex)) == 0);
+		allMatch = allMatch && match;
+
+		totalReference += referenceMs;
+		totalFast += fastMs;
+
+		std::cout << std::left << std::setw(28) << files[f] << std::right
+			<< std::setw(10) << fast.size() << std::setw(14) << referenceMs
+			<< std::setw(14) << fastMs << std::setw(9) << referenceMs / fastMs << "x"
+			<< "  " << (match ? "identical" : "DIFFERENT") << std::endl;
+	}
+
+	std::cout << std::left << std::setw(38) << "total" << std::right
+		<< std::setw(14) << totalReference << std::setw(14) << totalFast
+		<< std::setw(9) << totalReference / totalFast << "x" << std::endl;
+
+	return allMatch ? 0 : 2;
+}
@@ -0,0 +1,97 @@
+//-----------------------------------------------------------------------------
+// OBJ parse thread scaling benchmark
+//
+// Builds a large OBJ in memory by repeating a model (robot.obj by default)
+// and times ObjLoader::parse on it with 1..N threads, checking that every
+// thread count gives the same result.  From the repository root:
+//
+//   g++ -O2 -std=c++14 -pthread -I common/includes -I . benchmarks/ObjScalingBenchmark.cpp ObjLoader.cpp MappedFile.cpp -o objscaling
+//   ./objscaling [model.obj] [copies] [max threads]
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+
+#include "ObjLoader.h"
+#include "MappedFile.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static bool sameData(const ObjData& a, const ObjData& b)
+{
+	return a.positions == b.positions && a.texCoords == b.texCoords &&
+		a.normals == b.normals && a.corners == b.corners &&
+		memcmp(&a.bounds, &b.bounds, sizeof(MeshBounds)) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string filename = argc > 1 ? argv[1] : "models/robot.obj";
+	int copies = argc > 2 ? atoi(argv[2]) : 64;
+	unsigned int maxThreads = argc > 3 ? (unsigned int)atoi(argv[3]) : std::thread::hardware_concurrency();
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		std::cerr << "Cannot open " << filename << std::endl;
+		return 1;
+	}
+
+	// Face indices are absolute, so every copy still refers to valid vertices
+	std::vector<char> source;
+	source.reserve(file.size() * copies + copies);
+	for (int i = 0; i < copies; i++)
+	{
+		source.insert(source.end(), file.data(), file.data() + file.size());
+		source.push_back('\n');
+	}
+	file.close();
+
+	const char* begin = source.data();
+	const char* end = begin + source.size();
+	const int runs = 5;
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << filename << " x " << copies << " = " << source.size() / (1024.0 * 1024.0) << " MB" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(12) << "time (ms)" << std::setw(10) << "MB/s"
+		<< std::setw(10) << "speedup" << "  output" << std::endl;
+
+	ObjData reference;
+	double singleMs = 0.0;
+	bool allMatch = true;
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads++)
+	{
+		ObjData data;
+		double best = 1e30;
+		for (int i = 0; i < runs; i++)
+		{
+			Clock::time_point start = Clock::now();
+			ObjLoader::parse(begin, end, data, threads);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (ms < best)
+				best = ms;
+		}
+
+		if (threads == 1)
+		{
+			reference = data;
+			singleMs = best;
+		}
+
+		bool match = sameData(reference, data);
+		allMatch = allMatch && match;
+
+		std::cout << std::setw(8) << threads << std::setw(12) << best
+			<< std::setw(10) << source.size() / (1024.0 * 1024.0) / (best / 1000.0)
+			<< std::setw(9) << singleMs / best << "x"
+			<< "  " << (match ? "identical" : "DIFFERENT") << std::endl;
+	}
+
+	return allMatch ? 0 : 2;
+}
@@ -1,12 +1,9 @@
 #version 330 core
 
-struct Material 
-{
-    vec3 ambient;
-    sampler2D diffuseMap;
-    vec3 specular;
-    float shininess;
-};
+in vec2 TexCoord;
+in vec3 FragPos;
+in vec3 Normal;
+flat in int DiffuseLayer;	// >= 0: sample that layer of diffuseArray
 
 struct Light
 {
@@ -15,14 +12,26 @@ struct Light
 	vec3 diffuse;
 	vec3 specular;
 };
-  
-in vec2 TexCoord;
-in vec3 FragPos;
-in vec3 Normal;
 
-uniform Light light;
-uniform Material material;
-uniform vec3 viewPos;
+// Per-frame data, shared by all programs (binding 0)
+layout (std140) uniform FrameData
+{
+	mat4 view;			// view matrix
+	mat4 projection;	// projection matrix
+	vec3 viewPos;
+	Light light;
+};
+
+// Per-material data (binding 1)
+layout (std140) uniform MaterialData
+{
+	vec3 ambient;
+	vec3 specular;
+	float shininess;
+} material;
+
+uniform sampler2D diffuseMap;
+uniform sampler2DArray diffuseArray;
 
 out vec4 frag_color;
 
@@ -35,7 +44,8 @@ void main()
     vec3 normal = normalize(Normal); 
     vec3 lightDir = normalize(light.position - FragPos);
     float NdotL = max(dot(normal, lightDir), 0.0);
-    vec3 diffuse = light.diffuse * NdotL * vec3(texture(material.diffuseMap, TexCoord));
+    vec3 texel = (DiffuseLayer < 0) ? vec3(texture(diffuseMap, TexCoord)) : vec3(texture(diffuseArray, vec3(TexCoord, DiffuseLayer)));
+    vec3 diffuse = light.diffuse * NdotL * texel;
     
     // Specular - Blinn-Phong ----------------------------------------------------------
 	vec3 viewDir = normalize(viewPos - FragPos);
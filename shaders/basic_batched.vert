@@ -0,0 +1,68 @@
+#version 330 core
+
+layout (location = 0) in vec3 pos;			
+layout (location = 1) in vec3 normal;	
+layout (location = 2) in vec2 texCoord;
+layout (location = 7) in uint drawID;	// index of this draw in the batch (MeshArena)
+
+struct Light
+{
+	vec3 position;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// Per-frame data, shared by all programs (binding 0)
+layout (std140) uniform FrameData
+{
+	mat4 view;			// view matrix
+	mat4 projection;	// projection matrix
+	vec3 viewPos;
+	Light light;
+};
+
+// Per-draw data, 7 texels per draw: model matrix columns,
+// position offset (w: diffuseArray layer, -1 for diffuseMap),
+// position scale, uv offset and scale
+uniform samplerBuffer drawData;
+
+uniform bool octNormals;	// normal.xy holds an octahedral encoded normal
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out int DiffuseLayer;
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += (n.x >= 0.0f) ? -t : t;
+	n.y += (n.y >= 0.0f) ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	int base = int(drawID) * 7;
+	mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+		texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+	vec4 posOffsetLayer = texelFetch(drawData, base + 4);
+	vec3 posOffset = posOffsetLayer.xyz;
+	vec3 posScale = texelFetch(drawData, base + 5).xyz;
+	vec4 uvOffsetScale = texelFetch(drawData, base + 6);
+	vec2 uvOffset = uvOffsetScale.xy;
+	vec2 uvScale = uvOffsetScale.zw;
+
+	vec3 position = posOffset + posScale * pos;
+	vec3 objNormal = octNormals ? decodeOctahedral(normal.xy) : normal;
+
+    FragPos = vec3(model * vec4(position, 1.0f));			// vertex position in world space
+	Normal = mat3(transpose(inverse(model))) * objNormal;	// normal direction in world space
+	
+	TexCoord = uvOffset + uvScale * texCoord;
+	DiffuseLayer = int(posOffsetLayer.w);
+
+	gl_Position = projection * view *  model * vec4(position, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#version 330 core
+
+layout (location = 0) in vec3 pos;			
+layout (location = 1) in vec3 normal;	
+layout (location = 2) in vec2 texCoord;
+layout (location = 3) in mat4 model;	// per-instance model matrix (locations 3..6)
+
+struct Light
+{
+	vec3 position;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// Per-frame data, shared by all programs (binding 0)
+layout (std140) uniform FrameData
+{
+	mat4 view;			// view matrix
+	mat4 projection;	// projection matrix
+	vec3 viewPos;
+	Light light;
+};
+
+
+// Vertex dequantization (identity for float vertices)
+uniform vec3 posOffset;
+uniform vec3 posScale;
+uniform vec2 uvOffset;
+uniform vec2 uvScale;
+uniform bool octNormals;	// normal.xy holds an octahedral encoded normal
+
+uniform int diffuseLayer = -1;	// layer of diffuseArray, -1 samples diffuseMap
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out int DiffuseLayer;
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += (n.x >= 0.0f) ? -t : t;
+	n.y += (n.y >= 0.0f) ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 position = posOffset + posScale * pos;
+	vec3 objNormal = octNormals ? decodeOctahedral(normal.xy) : normal;
+
+    FragPos = vec3(model * vec4(position, 1.0f));			// vertex position in world space
+	Normal = mat3(transpose(inverse(model))) * objNormal;	// normal direction in world space
+	
+	TexCoord = uvOffset + uvScale * texCoord;
+	DiffuseLayer = diffuseLayer;
+
+	gl_Position = projection * view *  model * vec4(position, 1.0f);
+}
\ No newline at end of file
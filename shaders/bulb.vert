@@ -4,15 +4,34 @@ layout (location = 0) in vec3 pos;
 layout (location = 1) in vec3 normal;	
 layout (location = 2) in vec2 texCoord;
 
+struct Light
+{
+	vec3 position;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// Per-frame data, shared by all programs (binding 0)
+layout (std140) uniform FrameData
+{
+	mat4 view;			// view matrix
+	mat4 projection;	// projection matrix
+	vec3 viewPos;
+	Light light;
+};
+
 uniform mat4 model;			// model matrix
-uniform mat4 view;			// view matrix
-uniform mat4 projection;	// projection matrix
+
+// Vertex dequantization (identity for float vertices)
+uniform vec3 posOffset;
+uniform vec3 posScale;
 
 
 out vec2 TexCoord;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(pos, 1.0f);
+	gl_Position = projection * view * model * vec4(posOffset + posScale * pos, 1.0f);
 	TexCoord = texCoord;
 };
\ No newline at end of file
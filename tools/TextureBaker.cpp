@@ -0,0 +1,783 @@
+//-----------------------------------------------------------------------------
+// Texture baker
+//
+// Offline, headless: loads images (anything stb_image reads), builds the mip
+// chain with a gamma-correct 2x2 box filter (colors averaged in linear space,
+// SSE2 when available), encodes every level to BC1, BC3 or BC7 (mode 6) on
+// several threads and writes a KTX file that Texture2D loads directly.
+// Images are flipped to GL orientation (bottom row first) before encoding,
+// the same flip Texture2D does for uncompressed images.  From the
+// repository root:
+//
+//   g++ -O2 -std=c++14 -pthread -I common/includes tools/TextureBaker.cpp -o texbaker
+//   ./texbaker [-f auto|bc1|bc3|bc7] [-srgb] [-j threads] [-o dir] textures/*.jpg ...
+//
+// auto picks BC1 for opaque images and BC3 otherwise, both sampled by any
+// GL 3.3 driver with S3TC; BC7 needs GL 4.2 or ARB_texture_compression_bptc.
+// Without -srgb the UNORM formats are written, matching how Texture2D
+// uploads uncompressed images (GL_RGBA).  Each output goes next to its
+// input with a .ktx extension, or into -o dir (created if missing).
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#define STBI_NO_FAILURE_STRINGS
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image/stb_image.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BAKER_SSE
+#include <emmintrin.h>
+#endif
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// GL enums written to the KTX header (see TextureContainer)
+const unsigned int GL_RGBA_ENUM = 0x1908;
+const unsigned int GL_COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1;
+const unsigned int GL_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+const unsigned int GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1 = 0x8C4D;
+const unsigned int GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+const unsigned int GL_COMPRESSED_RGBA_BPTC = 0x8E8C;
+const unsigned int GL_COMPRESSED_SRGB_ALPHA_BPTC = 0x8E8D;
+
+enum BlockFormat
+{
+	FORMAT_AUTO,
+	FORMAT_BC1,
+	FORMAT_BC3,
+	FORMAT_BC7
+};
+
+// One mip level, RGBA8
+struct Image
+{
+	int width;
+	int height;
+	std::vector<unsigned char> pixels;
+};
+
+// A 4x4 block as floats, 0..255
+struct Block
+{
+	float pixels[16][4];
+};
+
+//-----------------------------------------------------------------------------
+// sRGB <-> linear
+//-----------------------------------------------------------------------------
+static float gSRGBToLinear[256];
+
+static void initSRGBTable()
+{
+	for (int i = 0; i < 256; i++)
+	{
+		float c = i / 255.0f;
+		gSRGBToLinear[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+}
+
+static unsigned char linearToSRGB(float c)
+{
+	c = std::min(std::max(c, 0.0f), 1.0f);
+	float s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+	return (unsigned char)(s * 255.0f + 0.5f);
+}
+
+//-----------------------------------------------------------------------------
+// Next mip level: each output pixel averages a 2x2 footprint (clamped at odd
+// edges) with RGB in linear space and alpha as is
+//-----------------------------------------------------------------------------
+static Image downsample(const Image& source)
+{
+	Image result;
+	result.width = std::max(1, source.width / 2);
+	result.height = std::max(1, source.height / 2);
+	result.pixels.resize((size_t)result.width * result.height * 4);
+
+	// Source converted once to linear floats, RGBA per pixel
+	std::vector<float> linear((size_t)source.width * source.height * 4);
+	for (size_t i = 0; i < (size_t)source.width * source.height; i++)
+	{
+		const unsigned char* p = &source.pixels[i * 4];
+		linear[i * 4 + 0] = gSRGBToLinear[p[0]];
+		linear[i * 4 + 1] = gSRGBToLinear[p[1]];
+		linear[i * 4 + 2] = gSRGBToLinear[p[2]];
+		linear[i * 4 + 3] = p[3] / 255.0f;
+	}
+
+	for (int y = 0; y < result.height; y++)
+	{
+		int y0 = std::min(y * 2, source.height - 1);
+		int y1 = std::min(y * 2 + 1, source.height - 1);
+		for (int x = 0; x < result.width; x++)
+		{
+			int x0 = std::min(x * 2, source.width - 1);
+			int x1 = std::min(x * 2 + 1, source.width - 1);
+			const float* a = &linear[((size_t)y0 * source.width + x0) * 4];
+			const float* b = &linear[((size_t)y0 * source.width + x1) * 4];
+			const float* c = &linear[((size_t)y1 * source.width + x0) * 4];
+			const float* d = &linear[((size_t)y1 * source.width + x1) * 4];
+
+			float average[4];
+#ifdef BAKER_SSE
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)), _mm_add_ps(_mm_loadu_ps(c), _mm_loadu_ps(d)));
+			_mm_storeu_ps(average, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+			for (int k = 0; k < 4; k++)
+				average[k] = (a[k] + b[k] + c[k] + d[k]) * 0.25f;
+#endif
+			unsigned char* out = &result.pixels[((size_t)y * result.width + x) * 4];
+			out[0] = linearToSRGB(average[0]);
+			out[1] = linearToSRGB(average[1]);
+			out[2] = linearToSRGB(average[2]);
+			out[3] = (unsigned char)(std::min(std::max(average[3], 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// Block fetch; blocks past the edge repeat the last row / column
+//-----------------------------------------------------------------------------
+static void fetchBlock(const Image& image, int blockX, int blockY, Block& block)
+{
+	for (int y = 0; y < 4; y++)
+	{
+		int py = std::min(blockY * 4 + y, image.height - 1);
+		for (int x = 0; x < 4; x++)
+		{
+			int px = std::min(blockX * 4 + x, image.width - 1);
+			const unsigned char* p = &image.pixels[((size_t)py * image.width + px) * 4];
+			for (int k = 0; k < 4; k++)
+				block.pixels[y * 4 + x][k] = p[k];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Principal axis of the block's first channelCount channels (power
+// iteration on the covariance), and the mean
+//-----------------------------------------------------------------------------
+static void principalAxis(const Block& block, int channelCount, float mean[4], float axis[4])
+{
+	for (int k = 0; k < 4; k++)
+		mean[k] = axis[k] = 0.0f;
+	for (int i = 0; i < 16; i++)
+		for (int k = 0; k < channelCount; k++)
+			mean[k] += block.pixels[i][k] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float d[4];
+		for (int k = 0; k < channelCount; k++)
+			d[k] = block.pixels[i][k] - mean[k];
+		for (int r = 0; r < channelCount; r++)
+			for (int c = 0; c < channelCount; c++)
+				covariance[r][c] += d[r] * d[c];
+	}
+
+	float v[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (int r = 0; r < channelCount; r++)
+		{
+			for (int c = 0; c < channelCount; c++)
+				next[r] += covariance[r][c] * v[c];
+			length += next[r] * next[r];
+		}
+		if (length < 1e-12f)
+			break;
+		length = sqrtf(length);
+		for (int r = 0; r < channelCount; r++)
+			v[r] = next[r] / length;
+	}
+	for (int k = 0; k < channelCount; k++)
+		axis[k] = v[k];
+}
+
+//-----------------------------------------------------------------------------
+// Endpoints at the extremes of the block's projection on the principal axis
+//-----------------------------------------------------------------------------
+static void axisEndpoints(const Block& block, int channelCount, float end0[4], float end1[4])
+{
+	float mean[4], axis[4];
+	principalAxis(block, channelCount, mean, axis);
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int k = 0; k < channelCount; k++)
+			t += (block.pixels[i][k] - mean[k]) * axis[k];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	for (int k = 0; k < 4; k++)
+	{
+		end0[k] = std::min(std::max(mean[k] + axis[k] * minT, 0.0f), 255.0f);
+		end1[k] = std::min(std::max(mean[k] + axis[k] * maxT, 0.0f), 255.0f);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Least squares endpoints for fixed per-pixel weights: each pixel is
+// modelled as (1 - t) * end0 + t * end1.  Returns false if degenerate.
+//-----------------------------------------------------------------------------
+static bool refitEndpoints(const Block& block, int channelCount, const float weights[16], float end0[4], float end1[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ap[4] = {}, bp[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float a = 1.0f - weights[i], b = weights[i];
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int k = 0; k < channelCount; k++)
+		{
+			ap[k] += a * block.pixels[i][k];
+			bp[k] += b * block.pixels[i][k];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+
+	for (int k = 0; k < channelCount; k++)
+	{
+		end0[k] = std::min(std::max((ap[k] * bb - bp[k] * ab) / determinant, 0.0f), 255.0f);
+		end1[k] = std::min(std::max((bp[k] * aa - ap[k] * ab) / determinant, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// BC1 color block (always the 4 color mode)
+//-----------------------------------------------------------------------------
+static unsigned short packRGB565(const float c[4])
+{
+	int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(unsigned short c, float out[3])
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	out[0] = (float)((r << 3) | (r >> 2));
+	out[1] = (float)((g << 2) | (g >> 4));
+	out[2] = (float)((b << 3) | (b >> 2));
+}
+
+// Encodes with the given endpoints; returns the squared error
+static float encodeColors(const Block& block, const float end0[4], const float end1[4], unsigned char out[8], int indices[16])
+{
+	unsigned short c0 = packRGB565(end0), c1 = packRGB565(end1);
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	float palette[4][3];
+	unpackRGB565(c0, palette[0]);
+	unpackRGB565(c1, palette[1]);
+	for (int k = 0; k < 3; k++)
+	{
+		palette[2][k] = (2.0f * palette[0][k] + palette[1][k]) / 3.0f;
+		palette[3][k] = (palette[0][k] + 2.0f * palette[1][k]) / 3.0f;
+	}
+
+	float error = 0.0f;
+	unsigned int bits = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		float bestError = 1e30f;
+		for (int p = 0; p < (c0 == c1 ? 1 : 4); p++)
+		{
+			float e = 0.0f;
+			for (int k = 0; k < 3; k++)
+			{
+				float d = block.pixels[i][k] - palette[p][k];
+				e += d * d;
+			}
+			if (e < bestError)
+			{
+				bestError = e;
+				best = p;
+			}
+		}
+		indices[i] = best;
+		error += bestError;
+		bits |= (unsigned int)best << (i * 2);
+	}
+
+	out[0] = (unsigned char)(c0 & 0xFF);
+	out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF);
+	out[3] = (unsigned char)(c1 >> 8);
+	memcpy(out + 4, &bits, 4);	// little endian, as the file
+	return error;
+}
+
+static void encodeBC1(const Block& block, unsigned char out[8])
+{
+	static const float INDEX_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	float end0[4], end1[4];
+	axisEndpoints(block, 3, end0, end1);
+
+	// 565 ordering may swap the endpoints; index weights are taken from the
+	// encoded palette, so the refit uses c0 as endpoint 0
+	int indices[16];
+	float error = encodeColors(block, end1, end0, out, indices);
+
+	unsigned short c0 = (unsigned short)(out[0] | (out[1] << 8));
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = INDEX_WEIGHTS[indices[i]];
+
+	float fit0[4], fit1[4];
+	unpackRGB565(c0, fit0);
+	if (refitEndpoints(block, 3, weights, fit0, fit1))
+	{
+		unsigned char refined[8];
+		int refinedIndices[16];
+		if (encodeColors(block, fit0, fit1, refined, refinedIndices) < error)
+			memcpy(out, refined, 8);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// BC3: an 8 alpha interpolated alpha block followed by a BC1 color block
+//-----------------------------------------------------------------------------
+static void encodeBC3(const Block& block, unsigned char out[16])
+{
+	float minA = 255.0f, maxA = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		minA = std::min(minA, block.pixels[i][3]);
+		maxA = std::max(maxA, block.pixels[i][3]);
+	}
+
+	int a0 = (int)(maxA + 0.5f), a1 = (int)(minA + 0.5f);
+	float palette[8] = { (float)a0, (float)a1 };
+	for (int p = 1; p < 7; p++)
+		palette[p + 1] = ((7 - p) * a0 + p * a1) / 7.0f;
+
+	unsigned long long bits = 0;
+	if (a0 != a1)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			for (int p = 1; p < 8; p++)
+			{
+				if (fabsf(block.pixels[i][3] - palette[p]) < fabsf(block.pixels[i][3] - palette[best]))
+					best = p;
+			}
+			bits |= (unsigned long long)best << (i * 3);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int b = 0; b < 6; b++)
+		out[2 + b] = (unsigned char)(bits >> (b * 8));
+
+	encodeBC1(block, out + 8);
+}
+
+//-----------------------------------------------------------------------------
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a p-bit each, 4 bit
+// indices
+//-----------------------------------------------------------------------------
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Best 7 bit + p-bit quantization of an endpoint
+static void quantizeBC7Endpoint(const float end[4], int q[4], int& pBit)
+{
+	float bestError = 1e30f;
+	for (int p = 0; p < 2; p++)
+	{
+		int candidate[4];
+		float error = 0.0f;
+		for (int k = 0; k < 4; k++)
+		{
+			candidate[k] = std::min(std::max((int)((end[k] - p) / 2.0f + 0.5f), 0), 127);
+			float d = (float)((candidate[k] << 1) | p) - end[k];
+			error += d * d;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			memcpy(q, candidate, sizeof(candidate));
+		}
+	}
+}
+
+struct BitWriter
+{
+	unsigned long long words[2];
+	int position;
+
+	void put(unsigned int value, int count)
+	{
+		for (int i = 0; i < count; i++, position++)
+		{
+			if (value & (1u << i))
+				words[position >> 6] |= 1ULL << (position & 63);
+		}
+	}
+};
+
+// Encodes with the given endpoints; returns the squared error
+static float encodeBC7Mode6(const Block& block, const float end0[4], const float end1[4], unsigned char out[16], int indices[16])
+{
+	int q[2][4], pBit[2];
+	quantizeBC7Endpoint(end0, q[0], pBit[0]);
+	quantizeBC7Endpoint(end1, q[1], pBit[1]);
+
+	int e[2][4];
+	for (int j = 0; j < 2; j++)
+		for (int k = 0; k < 4; k++)
+			e[j][k] = (q[j][k] << 1) | pBit[j];
+
+	float palette[16][4];
+	for (int p = 0; p < 16; p++)
+		for (int k = 0; k < 4; k++)
+			palette[p][k] = (float)(((64 - BC7_WEIGHTS[p]) * e[0][k] + BC7_WEIGHTS[p] * e[1][k] + 32) >> 6);
+
+	float error = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		float bestError = 1e30f;
+		for (int p = 0; p < 16; p++)
+		{
+			float d = 0.0f;
+			for (int k = 0; k < 4; k++)
+			{
+				float c = block.pixels[i][k] - palette[p][k];
+				d += c * c;
+			}
+			if (d < bestError)
+			{
+				bestError = d;
+				best = p;
+			}
+		}
+		indices[i] = best;
+		error += bestError;
+	}
+
+	// The anchor (pixel 0) index is stored without its top bit: swap the endpoints if it is set
+	if (indices[0] & 8)
+	{
+		for (int k = 0; k < 4; k++)
+			std::swap(q[0][k], q[1][k]);
+		std::swap(pBit[0], pBit[1]);
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	BitWriter writer = { { 0, 0 }, 0 };
+	writer.put(1 << 6, 7);		// mode 6: six 0 bits then a 1
+	for (int k = 0; k < 4; k++)
+	{
+		writer.put(q[0][k], 7);
+		writer.put(q[1][k], 7);
+	}
+	writer.put(pBit[0], 1);
+	writer.put(pBit[1], 1);
+	writer.put(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.put(indices[i], 4);
+
+	memcpy(out, writer.words, 16);
+	return error;
+}
+
+static void encodeBC7(const Block& block, unsigned char out[16])
+{
+	float end0[4], end1[4];
+	axisEndpoints(block, 4, end0, end1);
+
+	int indices[16];
+	float error = encodeBC7Mode6(block, end0, end1, out, indices);
+
+	// Refit to the chosen indices; the anchor swap may have flipped them, so
+	// weights follow the stored order
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+
+	float fit0[4], fit1[4];
+	if (refitEndpoints(block, 4, weights, fit0, fit1))
+	{
+		unsigned char refined[16];
+		int refinedIndices[16];
+		if (encodeBC7Mode6(block, fit0, fit1, refined, refinedIndices) < error)
+			memcpy(out, refined, 16);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Encodes one level, block rows shared out between the threads
+//-----------------------------------------------------------------------------
+static void encodeLevel(const Image& image, BlockFormat format, unsigned int threadCount, std::vector<unsigned char>& out)
+{
+	int blocksWide = (image.width + 3) / 4;
+	int blocksHigh = (image.height + 3) / 4;
+	size_t blockSize = (format == FORMAT_BC1) ? 8 : 16;
+	out.resize((size_t)blocksWide * blocksHigh * blockSize);
+
+	std::atomic<int> nextRow(0);
+	auto worker = [&]()
+	{
+		for (int by = nextRow++; by < blocksHigh; by = nextRow++)
+		{
+			for (int bx = 0; bx < blocksWide; bx++)
+			{
+				Block block;
+				fetchBlock(image, bx, by, block);
+				unsigned char* destination = &out[((size_t)by * blocksWide + bx) * blockSize];
+				if (format == FORMAT_BC1)
+					encodeBC1(block, destination);
+				else if (format == FORMAT_BC3)
+					encodeBC3(block, destination);
+				else
+					encodeBC7(block, destination);
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < std::min(threadCount, (unsigned int)blocksHigh); t++)
+		workers.push_back(std::thread(worker));
+	worker();
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
+
+//-----------------------------------------------------------------------------
+// KTX 1 writer: header, no key/value data, then each level's size and blocks
+//-----------------------------------------------------------------------------
+static bool writeKTX(const std::string& path, unsigned int internalFormat, int width, int height,
+	const std::vector<std::vector<unsigned char> >& levels)
+{
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	static const unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	unsigned int header[13] = {
+		0x04030201,				// endianness
+		0, 1, 0,				// glType, glTypeSize, glFormat: compressed
+		internalFormat,
+		GL_RGBA_ENUM,			// glBaseInternalFormat
+		(unsigned int)width, (unsigned int)height, 0,
+		0, 1,					// array elements, faces
+		(unsigned int)levels.size(),
+		0						// key/value bytes
+	};
+	file.write((const char*)IDENTIFIER, sizeof(IDENTIFIER));
+	file.write((const char*)header, sizeof(header));
+
+	// Block sizes are multiples of 8, so no mip padding is needed
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		unsigned int size = (unsigned int)levels[i].size();
+		file.write((const char*)&size, sizeof(size));
+		file.write((const char*)levels[i].data(), size);
+	}
+	return (bool)file;
+}
+
+static std::string getOutputPath(const std::string& input, const std::string& directory)
+{
+	std::string path = input;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		path = path.substr(0, dot);
+	path += ".ktx";
+
+	if (!directory.empty())
+		path = directory + "/" + (slash == std::string::npos ? path : path.substr(slash + 1));
+	return path;
+}
+
+//-----------------------------------------------------------------------------
+// Creates a directory and any missing parents; false if it still isn't one
+//-----------------------------------------------------------------------------
+static bool makeDirectory(const std::string& directory)
+{
+	// Prefixes that exist (or can't be made, like a drive) just fail; the final check decides
+	size_t end = 0;
+	do
+	{
+		end = directory.find_first_of("/\\", end + 1);
+		std::string path = directory.substr(0, end);
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+	} while (end != std::string::npos);
+
+	struct stat st;
+	return stat(directory.c_str(), &st) == 0 && (st.st_mode & S_IFDIR) != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Bakes one image; returns false on error
+//-----------------------------------------------------------------------------
+static bool bake(const std::string& input, const std::string& output, BlockFormat format, bool srgb, unsigned int threadCount)
+{
+	Clock::time_point start = Clock::now();
+
+	Image image;
+	int components;
+	unsigned char* data = stbi_load(input.c_str(), &image.width, &image.height, &components, STBI_rgb_alpha);
+	if (data == NULL)
+	{
+		std::cerr << "Error loading image '" << input << "'" << std::endl;
+		return false;
+	}
+
+	// GL orientation: bottom row first
+	size_t rowBytes = (size_t)image.width * 4;
+	image.pixels.resize(rowBytes * image.height);
+	for (int row = 0; row < image.height; row++)
+		memcpy(&image.pixels[row * rowBytes], data + (image.height - 1 - row) * rowBytes, rowBytes);
+	stbi_image_free(data);
+
+	if (format == FORMAT_AUTO)
+	{
+		format = FORMAT_BC1;
+		for (size_t i = 3; i < image.pixels.size(); i += 4)
+		{
+			if (image.pixels[i] != 255)
+			{
+				format = FORMAT_BC3;
+				break;
+			}
+		}
+	}
+
+	unsigned int internalFormat;
+	if (format == FORMAT_BC1)
+		internalFormat = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1 : GL_COMPRESSED_RGBA_S3TC_DXT1;
+	else if (format == FORMAT_BC3)
+		internalFormat = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 : GL_COMPRESSED_RGBA_S3TC_DXT5;
+	else
+		internalFormat = srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC : GL_COMPRESSED_RGBA_BPTC;
+
+	int width = image.width, height = image.height;
+	std::vector<std::vector<unsigned char> > levels;
+	for (;;)
+	{
+		levels.push_back(std::vector<unsigned char>());
+		encodeLevel(image, format, threadCount, levels.back());
+
+		if (image.width == 1 && image.height == 1)
+			break;
+		image = downsample(image);
+	}
+
+	if (!writeKTX(output, internalFormat, width, height, levels))
+	{
+		std::cerr << "Error writing '" << output << "'" << std::endl;
+		return false;
+	}
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < levels.size(); i++)
+		bytes += levels[i].size();
+
+	static const char* FORMAT_NAMES[] = { "auto", "BC1", "BC3", "BC7" };
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	std::cout << input << " -> " << output << ": " << width << "x" << height << " " << FORMAT_NAMES[format]
+		<< (srgb ? " sRGB" : "") << ", " << levels.size() << " levels, " << bytes / 1024 << " KB (RGBA8 with mips "
+		<< (size_t)width * height * 4 * 4 / 3 / 1024 << " KB), "
+		<< std::fixed << std::setprecision(1) << seconds * 1000.0 << " ms" << std::endl;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	BlockFormat format = FORMAT_AUTO;
+	bool srgb = false;
+	unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::string directory;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-f" && i + 1 < argc)
+		{
+			std::string name = argv[++i];
+			if (name == "auto") format = FORMAT_AUTO;
+			else if (name == "bc1") format = FORMAT_BC1;
+			else if (name == "bc3") format = FORMAT_BC3;
+			else if (name == "bc7") format = FORMAT_BC7;
+			else
+			{
+				std::cerr << "Unknown format '" << name << "'" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-srgb")
+			srgb = true;
+		else if (arg == "-j" && i + 1 < argc)
+			threadCount = (unsigned int)std::max(1, atoi(argv[++i]));
+		else if (arg == "-o" && i + 1 < argc)
+			directory = argv[++i];
+		else
+			inputs.push_back(arg);
+	}
+
+	if (inputs.empty())
+	{
+		std::cerr << "usage: texbaker [-f auto|bc1|bc3|bc7] [-srgb] [-j threads] [-o dir] images..." << std::endl;
+		return 1;
+	}
+
+	if (!directory.empty() && !makeDirectory(directory))
+	{
+		std::cerr << "Cannot create output directory '" << directory << "'" << std::endl;
+		return 1;
+	}
+
+	initSRGBTable();
+
+	int failures = 0;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		if (!bake(inputs[i], getOutputPath(inputs[i], directory), format, srgb, threadCount))
+			failures++;
+	}
+	return failures == 0 ? 0 : 1;
+}